@@ -0,0 +1,266 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "m_tree.h"
+
+/*
+================
+Manage benchmark
+
+Replays top-level window lifetimes against the node tree under two
+policies: framing every top-level when it's created, as makron used to,
+and framing it at its first map and dropping the frame when it's
+withdrawn, as it does now. For each it reports the frame windows created
+over the run, and the most frames and nodes alive at once.
+
+A trace file can be given, one event per line: "create", "map", "unmap"
+or "destroy", then a window id. Without one, two built-in traces are
+replayed. The first is soak.sh's workload, ten xclocks and ten xeyes
+started and killed each round. The second is a desktop session with the
+top-levels each toolkit creates on startup (see sessionApps).
+================
+*/
+
+typedef enum {
+	EV_CREATE,
+	EV_MAP,
+	EV_UNMAP,
+	EV_DESTROY
+} eventType_t;
+
+typedef struct {
+	eventType_t type;
+	unsigned int window;
+} event_t;
+
+typedef struct {
+	event_t* events;
+	int count, max;
+} trace_t;
+
+typedef struct {
+	long framesCreated;
+	long liveFrames, peakFrames;
+	long liveNodes, peakNodes;
+} policyStats_t;
+
+// what one client of each kind creates at startup: mapped top-levels, and
+// top-levels that are never mapped, and how often it shows and hides a dialog
+typedef struct {
+	const char* name;
+	int count;
+	int mapped;
+	int hidden; // toolkit leader, clipboard and selection windows
+	int dialogShows;
+} appKind_t;
+
+static const appKind_t sessionApps[] = {
+	{ "Xt", 4, 1, 0, 0 }, // one application shell
+	{ "GTK 3", 6, 1, 1, 3 }, // plus the client leader
+	{ "Qt 5", 4, 1, 3, 3 }, // plus the client leader, clipboard owner and requestor
+};
+
+static void Add( trace_t* t, eventType_t type, unsigned int window ) {
+	if ( t->count == t->max ) {
+		t->max = t->max ? t->max * 2 : 64;
+		t->events = realloc( t->events, t->max * sizeof( event_t ) );
+		if ( !t->events ) {
+			fprintf( stderr, "couldn't grow trace\n" );
+			exit( 1 );
+		}
+	}
+	t->events[t->count].type = type;
+	t->events[t->count].window = window;
+	t->count++;
+}
+
+static void SoakTrace( trace_t* t, int rounds ) {
+	unsigned int w = 0x100;
+	int r, i;
+
+	for ( r = 0; r < rounds; r++ ) {
+		for ( i = 0; i < 20; i++ ) {
+			Add( t, EV_CREATE, w + i );
+			Add( t, EV_MAP, w + i );
+		}
+		for ( i = 0; i < 20; i++ )
+			Add( t, EV_DESTROY, w + i );
+		w += 20;
+	}
+}
+
+static void SessionTrace( trace_t* t ) {
+	unsigned int w = 0x100, first;
+	int k, a, i, s, windows;
+
+	first = w;
+	for ( k = 0; k < (int)( sizeof( sessionApps ) / sizeof( sessionApps[0] ) ); k++ ) {
+		for ( a = 0; a < sessionApps[k].count; a++ ) {
+			for ( i = 0; i < sessionApps[k].hidden; i++ )
+				Add( t, EV_CREATE, w++ );
+			for ( i = 0; i < sessionApps[k].mapped; i++ ) {
+				Add( t, EV_CREATE, w );
+				Add( t, EV_MAP, w++ );
+			}
+			// a dialog kept around and shown again, as toolkits do
+			if ( sessionApps[k].dialogShows ) {
+				Add( t, EV_CREATE, w );
+				for ( s = 0; s < sessionApps[k].dialogShows; s++ ) {
+					Add( t, EV_MAP, w );
+					Add( t, EV_UNMAP, w );
+				}
+				w++;
+			}
+		}
+	}
+	windows = w - first;
+	for ( i = 0; i < windows; i++ )
+		Add( t, EV_DESTROY, first + i );
+}
+
+static int LoadTrace( trace_t* t, const char* path ) {
+	FILE* f = fopen( path, "r" );
+	char type[16];
+	unsigned int window;
+
+	if ( !f ) {
+		perror( path );
+		return -1;
+	}
+	while ( fscanf( f, "%15s %x", type, &window ) == 2 ) {
+		if ( !strcmp( type, "create" ) )
+			Add( t, EV_CREATE, window );
+		else if ( !strcmp( type, "map" ) )
+			Add( t, EV_MAP, window );
+		else if ( !strcmp( type, "unmap" ) )
+			Add( t, EV_UNMAP, window );
+		else if ( !strcmp( type, "destroy" ) )
+			Add( t, EV_DESTROY, window );
+	}
+	fclose( f );
+	return 0;
+}
+
+static void Count( policyStats_t* s, int frames, int nodes ) {
+	s->liveFrames += frames;
+	s->liveNodes += nodes;
+	if ( frames > 0 )
+		s->framesCreated += frames;
+	if ( s->liveFrames > s->peakFrames )
+		s->peakFrames = s->liveFrames;
+	if ( s->liveNodes > s->peakNodes )
+		s->peakNodes = s->liveNodes;
+}
+
+// puts n in a frame of its own the way CreateFrame and Reframe do
+static void Frame( node_t* n, policyStats_t* s ) {
+	node_t* p = CreateNode( NODE_FRAME, n->window | 0x80000000u, rootNode, n->width, n->height, n->x, n->y );
+
+	RemoveNodeFromList( n, &rootNode->children );
+	AddNodeToList( p, &windowList );
+	AddNodeToList( p, &rootNode->children );
+	AddNodeToList( n, &p->children );
+	n->parent = p;
+	Count( s, 1, 1 );
+}
+
+// takes n back out to the root the way Unframe does
+static void Unframe( node_t* n, policyStats_t* s ) {
+	node_t* p = n->parent;
+
+	RemoveNodeFromList( n, &p->children );
+	n->parent = rootNode;
+	AddNodeToList( n, &rootNode->children );
+	DestroyNode( p );
+	Count( s, -1, -1 );
+}
+
+static void Replay( const trace_t* t, int lazy, policyStats_t* s ) {
+	node_t* n;
+	int i;
+
+	memset( s, 0, sizeof( *s ) );
+	rootNode = CreateNode( NODE_ROOT, 1, NULL, 1920, 1080, 0, 0 );
+	AddNodeToList( rootNode, &windowList );
+
+	for ( i = 0; i < t->count; i++ ) {
+		n = GetNodeByWindow( t->events[i].window );
+		switch ( t->events[i].type ) {
+			case EV_CREATE:
+				if ( n )
+					break;
+				n = CreateNode( NODE_CLIENT, t->events[i].window, rootNode, 640, 480, 0, 0 );
+				AddNodeToList( n, &windowList );
+				AddNodeToList( n, &rootNode->children );
+				Count( s, 0, 1 );
+				if ( !lazy )
+					Frame( n, s );
+				break;
+			case EV_MAP:
+				if ( n && lazy && n->parent == rootNode )
+					Frame( n, s );
+				break;
+			case EV_UNMAP:
+				if ( n && lazy && n->parent != rootNode )
+					Unframe( n, s );
+				break;
+			case EV_DESTROY:
+				if ( !n )
+					break;
+				// an empty frame goes with its client
+				Count( s, n->parent != rootNode ? -1 : 0, n->parent != rootNode ? -2 : -1 );
+				DestroyNode( n );
+				break;
+		}
+	}
+
+	// whatever the trace left alive
+	while ( rootNode->children.nodes[0] != NULL ) {
+		n = rootNode->children.nodes[0];
+		if ( n->type == NODE_FRAME )
+			n = n->children.nodes[0];
+		DestroyNode( n );
+	}
+	RemoveNodeFromList( rootNode, &windowList );
+	AcctFree( ACCT_LISTS, rootNode->children.nodes );
+	AcctFree( ACCT_NODES, rootNode );
+	AcctFree( ACCT_LISTS, windowList.nodes );
+	AcctFree( ACCT_LISTS, redrawList.nodes );
+	windowList.nodes = redrawList.nodes = NULL;
+	windowList.max = redrawList.max = 0;
+	rootNode = NULL;
+}
+
+static void Report( const char* name, const trace_t* t ) {
+	policyStats_t eager, lazy;
+
+	Replay( t, 0, &eager );
+	Replay( t, 1, &lazy );
+	printf( "%-10s %-9s %10li %10li %10li\n", name, "create", eager.framesCreated, eager.peakFrames, eager.peakNodes );
+	printf( "%-10s %-9s %10li %10li %10li\n", "", "map", lazy.framesCreated, lazy.peakFrames, lazy.peakNodes );
+	printf( "%-10s %-9s %10li %10li %10li\n", "", "saved", eager.framesCreated - lazy.framesCreated,
+		eager.peakFrames - lazy.peakFrames, eager.peakNodes - lazy.peakNodes );
+}
+
+int main( int argc, char** argv ) {
+	trace_t soak = { 0 }, session = { 0 }, file = { 0 };
+
+	debugLevel = 0;
+	printf( "%-10s %-9s %10s %10s %10s\n", "trace", "frames at", "created", "peak", "peak nodes" );
+	if ( argc > 1 ) {
+		if ( LoadTrace( &file, argv[1] ) < 0 )
+			return 1;
+		Report( argv[1], &file );
+		free( file.events );
+		return 0;
+	}
+	// a minute of soak.sh
+	SoakTrace( &soak, 60 );
+	Report( "soak", &soak );
+	SessionTrace( &session );
+	Report( "session", &session );
+	free( soak.events );
+	free( session.events );
+	return 0;
+}
@@ -0,0 +1,128 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "m_tree.h"
+#include "m_scale.h"
+
+/*
+===============
+Scale benchmark
+
+Times ScaleImage on the wallpaper sizes that matter, scaling up, down and
+across aspect ratios to 4K, and checks every output against a plain
+per-pixel version of the same arithmetic. An optional argument gives a
+budget in milliseconds per scale; exceeding it fails the run.
+===============
+*/
+
+#define RUNS 5
+
+static unsigned int seed = 12345;
+
+static unsigned int Random( void ) {
+	seed = seed * 1103515245 + 12345;
+	return seed >> 8;
+}
+
+static double Now( void ) {
+	struct timespec ts;
+	clock_gettime( CLOCK_MONOTONIC, &ts );
+	return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+// the same sample positions as m_scale.c
+static void SamplePosition( int i, int count, int size, int* first, int* weight ) {
+	long long pos = ( ( 2LL * i + 1 ) * size * 256 ) / ( 2LL * count ) - 128;
+
+	if ( pos < 0 )
+		pos = 0;
+	*first = pos >> 8;
+	*weight = pos & 255;
+	if ( size < 2 ) {
+		*first = 0;
+		*weight = 0;
+	} else if ( *first >= size - 1 ) {
+		*first = size - 2;
+		*weight = 256;
+	}
+}
+
+static int Check( const unsigned char* src, int sw, int sh, const unsigned char* dst, int dw, int dh ) {
+	int x, y, k, x0, y0, wx, wy, top, bottom, rows, cols;
+
+	for ( y = 0; y < dh; y++ ) {
+		SamplePosition( y, dh, sh, &y0, &wy );
+		rows = sh < 2 ? 0 : 1;
+		for ( x = 0; x < dw; x++ ) {
+			SamplePosition( x, dw, sw, &x0, &wx );
+			cols = sw < 2 ? 0 : 1;
+			for ( k = 0; k < 4; k++ ) {
+				const unsigned char* a = src + ( (size_t)y0 * sw + x0 ) * 4 + k;
+				const unsigned char* b = a + (size_t)rows * sw * 4;
+				top = ( a[0] * ( 256 - wx ) + a[cols * 4] * wx ) >> 8;
+				bottom = ( b[0] * ( 256 - wx ) + b[cols * 4] * wx ) >> 8;
+				if ( dst[( (size_t)y * dw + x ) * 4 + k] != ( ( top * ( 256 - wy ) + bottom * wy ) >> 8 ) )
+					return 1;
+			}
+		}
+	}
+	return 0;
+}
+
+static int Run( int sw, int sh, int dw, int dh, double budget ) {
+	unsigned char* src = malloc( (size_t)sw * sh * 4 );
+	unsigned char* dst = malloc( (size_t)dw * dh * 4 );
+	double t, best = 0;
+	size_t i;
+	int r, bad;
+
+	if ( !src || !dst ) {
+		fprintf( stderr, "couldn't allocate %ix%i -> %ix%i\n", sw, sh, dw, dh );
+		free( src );
+		free( dst );
+		return 1;
+	}
+	for ( i = 0; i < (size_t)sw * sh * 4; i++ )
+		src[i] = Random();
+
+	for ( r = 0; r < RUNS; r++ ) {
+		t = Now();
+		ScaleImage( src, sw, sh, sw * 4, dst, dw, dh, dw * 4 );
+		t = ( Now() - t ) / 1e6;
+		if ( r == 0 || t < best )
+			best = t;
+	}
+	bad = Check( src, sw, sh, dst, dw, dh );
+
+	printf( "%5ix%-5i -> %5ix%-5i %10.2f %10.1f %8s\n", sw, sh, dw, dh, best,
+		(double)dw * dh / 1e6 / ( best / 1e3 ), bad ? "WRONG" : "ok" );
+	free( src );
+	free( dst );
+	return bad || ( budget > 0 && best > budget );
+}
+
+int main( int argc, char** argv ) {
+	int sizes[][4] = {
+		{ 1920, 1080, 3840, 2160 },
+		{ 2560, 1440, 3840, 2160 },
+		{ 5120, 2880, 3840, 2160 },
+		{ 3840, 2160, 3840, 2160 },
+		{ 1600, 1200, 3840, 2160 },
+		{ 1, 1, 1920, 1080 },
+		{ 4000, 3000, 1920, 1080 },
+	};
+	double budget = argc > 1 ? atof( argv[1] ) : 0;
+	int i, failed = 0;
+
+	debugLevel = 0;
+	printf( "scaling with %s\n", ScalePath() );
+	printf( "%-26s %10s %10s %8s\n", "size", "ms", "Mpix/s", "output" );
+	for ( i = 0; i < (int)( sizeof( sizes ) / sizeof( sizes[0] ) ); i++ )
+		failed |= Run( sizes[i][0], sizes[i][1], sizes[i][2], sizes[i][3], budget );
+
+	if ( failed )
+		fprintf( stderr, "wrong output, or over budget of %.1f ms\n", budget );
+	return failed;
+}
@@ -0,0 +1,140 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "m_tree.h"
+
+/*
+==============
+Tree benchmark
+
+Builds trees of frames and clients the same way ReparentWindow does and
+times insert, lookup, raise and remove against them, and a teardown of
+many clients at once the way a batch of DestroyNotify events goes, using
+the tree's default backend so no display is needed. An optional argument gives a
+per-operation budget in nanoseconds; exceeding it fails the run.
+==============
+*/
+
+#define OPS 1000
+
+static unsigned int seed = 12345;
+
+static unsigned int Random( void ) {
+	seed = seed * 1103515245 + 12345;
+	return seed >> 8;
+}
+
+static double Now( void ) {
+	struct timespec ts;
+	clock_gettime( CLOCK_MONOTONIC, &ts );
+	return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static void DrainRedrawList( void ) {
+	while ( redrawList.nodes[0] != NULL )
+		RemoveNodeFromList( redrawList.nodes[0], &redrawList );
+}
+
+// frees whatever is left without going through the lists
+static void FreeTree( void ) {
+	int i;
+
+	for ( i = 0; ( i < windowList.max ) && ( windowList.nodes[i] != NULL ); i++ ) {
+		AcctFree( ACCT_LISTS, windowList.nodes[i]->children.nodes );
+		AcctFree( ACCT_NODES, windowList.nodes[i] );
+	}
+	AcctFree( ACCT_LISTS, windowList.nodes );
+	AcctFree( ACCT_LISTS, redrawList.nodes );
+	windowList.nodes = redrawList.nodes = NULL;
+	windowList.max = redrawList.max = 0;
+	rootNode = NULL;
+}
+
+static int CountList( nodeList_t* list ) {
+	int i;
+
+	for ( i = 0; ( i < list->max ) && ( list->nodes[i] != NULL ); i++ )
+		;;
+	return i;
+}
+
+static int Run( int size, double budget ) {
+	int frames = size / 2;
+	node_t** clients = calloc( frames, sizeof( node_t* ) );
+	node_t* frame;
+	double t, insert, lookup, raise, remove, teardown;
+	int i, ops = frames < OPS ? frames : OPS;
+	int removes = ( ops + 1 ) / 2, teardowns = ops / 2;
+
+	rootNode = CreateNode( NODE_ROOT, 1, NULL, 1920, 1080, 0, 0 );
+	AddNodeToList( rootNode, &windowList );
+	AddNodeToList( rootNode, &redrawList );
+	RemoveNodeFromList( rootNode, &redrawList );
+
+	t = Now();
+	for ( i = 0; i < frames; i++ ) {
+		frame = CreateNode( NODE_FRAME, 2 * i + 2, rootNode, 640, 480, 0, 0 );
+		clients[i] = CreateNode( NODE_CLIENT, 2 * i + 3, frame, 640, 480, 0, 0 );
+		AddNodeToList( frame, &windowList );
+		AddNodeToList( frame, &rootNode->children );
+		AddNodeToList( clients[i], &frame->children );
+		AddNodeToList( clients[i], &windowList );
+	}
+	insert = ( Now() - t ) / ( frames * 2 );
+
+	t = Now();
+	for ( i = 0; i < ops; i++ ) {
+		if ( GetNodeByWindow( 2 * ( Random() % frames ) + 3 ) == NULL )
+			fprintf( stderr, "lookup failed\n" );
+	}
+	lookup = ( Now() - t ) / ops;
+
+	t = Now();
+	for ( i = 0; i < ops; i++ ) {
+		RaiseClient( clients[Random() % frames] );
+		DrainRedrawList();
+	}
+	raise = ( Now() - t ) / ops;
+
+	// spread the removals across the list rather than taking one end, one
+	// at a time for half and as a single batch for the other half
+	t = Now();
+	for ( i = 0; i < ops; i += 2 )
+		DestroyNode( clients[i * ( frames / ops )] );
+	remove = ( Now() - t ) / removes;
+
+	t = Now();
+	for ( i = 1; i < ops; i += 2 )
+		QueueDestroy( clients[i * ( frames / ops )] );
+	ReapNodes();
+	teardown = teardowns ? ( Now() - t ) / teardowns : 0;
+
+	// each client took its frame with it
+	if ( CountList( &windowList ) != 1 + 2 * ( frames - ops ) || CountList( &rootNode->children ) != frames - ops )
+		fprintf( stderr, "teardown left %i nodes, expected %i\n", CountList( &windowList ), 1 + 2 * ( frames - ops ) );
+
+	printf( "%8i %12.1f %12.1f %12.1f %12.1f %12.1f\n", size, insert, lookup, raise, remove, teardown );
+
+	FreeTree();
+	free( clients );
+
+	if ( budget > 0 && ( insert > budget || lookup > budget || raise > budget || remove > budget || teardown > budget ) )
+		return 1;
+	return 0;
+}
+
+int main( int argc, char** argv ) {
+	int sizes[] = { 10, 100, 1000, 10000, 100000 };
+	double budget = argc > 1 ? atof( argv[1] ) : 0;
+	int i, failed = 0;
+
+	debugLevel = 0;
+	printf( "%8s %12s %12s %12s %12s %12s   (ns/op)\n", "nodes", "insert", "lookup", "raise", "remove", "teardown" );
+	for ( i = 0; i < (int)( sizeof( sizes ) / sizeof( sizes[0] ) ); i++ )
+		failed |= Run( sizes[i], budget );
+
+	if ( failed )
+		fprintf( stderr, "over budget of %.0f ns/op\n", budget );
+	return failed;
+}
@@ -0,0 +1,62 @@
+#!/bin/sh
+# churns client windows under Xvfb and checks that makron's memory and
+# X resource usage stay flat. SOAK_SECONDS sets how long to run for.
+
+duration=${SOAK_SECONDS:-3600}
+rsslimit=${SOAK_RSS_LIMIT:-1024}
+workdir=$(mktemp -d)
+
+Xvfb :11 -screen 0 1152x864x24 &
+xpid=$!
+
+sleep 0.5
+
+export DISPLAY=:11
+HOME=$workdir ./build/makron --account > $workdir/makron.log 2>&1 &
+wmpid=$!
+sleep 0.5
+
+rss() {
+	awk '/VmRSS/ { print $2 }' /proc/$wmpid/status
+}
+
+start=$(date +%s)
+rounds=0
+while [ $(( $(date +%s) - start )) -lt $duration ]; do
+	pids=""
+	for i in 1 2 3 4 5 6 7 8 9 10; do
+		xclock &
+		pids="$pids $!"
+		xeyes &
+		pids="$pids $!"
+	done
+	sleep 1
+	kill $pids
+	wait $pids 2>/dev/null
+	rounds=$(( rounds + 1 ))
+	# let the heap settle before taking the baseline
+	if [ $rounds -eq 10 ]; then
+		baseline=$(rss)
+	fi
+	if [ $(( rounds % 60 )) -eq 0 ]; then
+		HOME=$workdir ./build/makron-reload stats
+		echo "round $rounds: rss $(rss) kB"
+	fi
+done
+
+final=$(rss)
+kill $wmpid
+wait $wmpid
+kill $xpid
+
+status=0
+if ! grep -q "^leaks: 0$" $workdir/makron-leaks.txt; then
+	echo "makron leaked:"
+	status=1
+fi
+cat $workdir/makron-leaks.txt
+if [ -n "$baseline" ] && [ $(( final - baseline )) -gt $rsslimit ]; then
+	echo "rss grew from $baseline kB to $final kB over $rounds rounds"
+	status=1
+fi
+exit $status
@@ -0,0 +1,127 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+
+#include "m_tree.h"
+
+/*
+==========
+Accounting
+
+Live heap blocks and X resource ids are counted per subsystem. Counting
+is always on since it's only a few increments; accountingEnabled decides
+whether Cleanup writes a leak report.
+==========
+*/
+
+bool accountingEnabled = false;
+
+typedef struct {
+	long live;
+	long total;
+	long peak;
+} acctCounter_t;
+
+static acctCounter_t memCounters[ACCT_MEM_COUNT];
+static acctCounter_t xCounters[ACCT_X_COUNT];
+
+static const char* memNames[ACCT_MEM_COUNT] = {
+	"nodes",
+	"lists",
+	"restart",
+	"messages",
+	"startup",
+	"text",
+	"trace",
+	"rules",
+	"images",
+};
+
+static const char* xNames[ACCT_X_COUNT] = {
+	"windows",
+	"gcs",
+	"pixmaps",
+	"fonts",
+	"cursors",
+	"pictures",
+	"glyphsets",
+};
+
+static void CountUp( acctCounter_t* counter ) {
+	counter->live++;
+	counter->total++;
+	if ( counter->live > counter->peak )
+		counter->peak = counter->live;
+}
+
+void* AcctCalloc( acctMem_t kind, size_t count, size_t size ) {
+	void* p = calloc( count, size );
+
+	if ( p )
+		CountUp( &memCounters[kind] );
+	return p;
+}
+
+void* AcctRealloc( acctMem_t kind, void* ptr, size_t size ) {
+	void* p = realloc( ptr, size );
+
+	if ( p && !ptr )
+		CountUp( &memCounters[kind] );
+	return p;
+}
+
+void AcctFree( acctMem_t kind, void* ptr ) {
+	if ( !ptr )
+		return;
+	memCounters[kind].live--;
+	free( ptr );
+}
+
+void AcctXCreate( acctXRes_t kind ) {
+	CountUp( &xCounters[kind] );
+}
+
+void AcctXFree( acctXRes_t kind ) {
+	xCounters[kind].live--;
+}
+
+void AcctReport( FILE* f ) {
+	int i;
+
+	fprintf( f, "%-10s %10s %10s %10s\n", "heap", "live", "peak", "total" );
+	for ( i = 0; i < ACCT_MEM_COUNT; i++ )
+		fprintf( f, "%-10s %10li %10li %10li\n", memNames[i], memCounters[i].live, memCounters[i].peak, memCounters[i].total );
+	fprintf( f, "%-10s %10s %10s %10s\n", "x ids", "live", "peak", "total" );
+	for ( i = 0; i < ACCT_X_COUNT; i++ )
+		fprintf( f, "%-10s %10li %10li %10li\n", xNames[i], xCounters[i].live, xCounters[i].peak, xCounters[i].total );
+	fprintf( f, "%-10s %10s %10s %10s\n", "stacking", "raises", "skipped", "restacks" );
+	fprintf( f, "%-10s %10li %10li %10li  (%.2f per raise)\n", "", raiseCount, raiseSkipCount, restackCount,
+		raiseCount ? (double)restackCount / raiseCount : 0.0 );
+	fprintf( f, "%-10s %10s %10s\n", "teardown", "reaps", "nodes" );
+	fprintf( f, "%-10s %10li %10li  (%.2f per reap)\n", "", reapCount, reapedCount,
+		reapCount ? (double)reapedCount / reapCount : 0.0 );
+}
+
+// called after Cleanup has torn everything down, so anything live is a leak.
+// returns the number of leaked blocks and ids.
+long AcctLeakReport( const char* path ) {
+	long leaks = 0;
+	FILE* f;
+	int i;
+
+	for ( i = 0; i < ACCT_MEM_COUNT; i++ )
+		leaks += memCounters[i].live;
+	for ( i = 0; i < ACCT_X_COUNT; i++ )
+		leaks += xCounters[i].live;
+
+	f = fopen( path, "w" );
+	if ( !f ) {
+		fprintf( stderr, "couldn't write leak report to %s\n", path );
+		return leaks;
+	}
+	fprintf( f, "leaks: %li\n\n", leaks );
+	AcctReport( f );
+	fclose( f );
+	return leaks;
+}
@@ -11,19 +11,10 @@
 
 #define FONT_NAME "fixed"
 
-typedef enum {
-	STATE_WITHDRAWN = 0,
-	STATE_ICON = 1,
-	STATE_NORMAL = 3,
-} clientWindowState_t;
+// held down to move or resize a window from anywhere inside it
+#define DRAG_MODIFIER XCB_MOD_MASK_1
 
-typedef enum {
-	STATE_INIT,
-	STATE_NO_REDIRECT, //override redirect
-	STATE_REPARENTED,
-	STATE_CHILD,
-	STATE_TRANSIENT
-} clientManagementState_t;
+#define LEAK_REPORT_NAME "makron-leaks.txt"
 
 typedef enum {
 	WMSTATE_IDLE,
@@ -32,31 +23,226 @@ typedef enum {
 	WMSTATE_CLOSE
 } wmState_t;
 
+#include "m_tree.h"
+#include "m_scale.h"
+
+#define FRAME_EVENT_MASK ( XCB_EVENT_MASK_EXPOSURE | \
+							XCB_EVENT_MASK_BUTTON_PRESS | \
+							XCB_EVENT_MASK_BUTTON_RELEASE | \
+							XCB_EVENT_MASK_POINTER_MOTION | \
+							XCB_EVENT_MASK_SUBSTRUCTURE_NOTIFY | \
+							XCB_EVENT_MASK_SUBSTRUCTURE_REDIRECT )
+
+#define CLIENT_EVENT_MASK ( XCB_EVENT_MASK_EXPOSURE | \
+							XCB_EVENT_MASK_PROPERTY_CHANGE | \
+							XCB_EVENT_MASK_SUBSTRUCTURE_NOTIFY | \
+							XCB_EVENT_MASK_SUBSTRUCTURE_REDIRECT )
+
+/* main.c */
+extern xcb_connection_t *c;
+extern xcb_screen_t *screen;
+extern sulfurColor_t colorDarkGrey;
+extern sulfurColor_t colorBlack;
+
+node_t* CreateFrame( node_t* n, short x, short y );
+void ConfigureClient( node_t *n, short x, short y, unsigned short width, unsigned short height );
+void ConfigureReport( FILE* f );
+void SetupFontGcs( void );
+void ShowClient( node_t* n );
+void ShowClientBehind( node_t* n, node_t* focused );
+void EndDrag( void );
+void Quit( int r );
+extern wmState_t wmState;
+extern xcb_atom_t _MOTIF_WM_HINTS;
+extern xcb_atom_t _GTK_FRAME_EXTENTS;
+extern xcb_atom_t _NET_WM_NAME;
+extern xcb_atom_t UTF8_STRING;
+extern xcb_atom_t WM_WINDOW_ROLE;
+extern xcb_atom_t _NET_WM_STATE;
+extern xcb_atom_t _NET_WM_STATE_FULLSCREEN;
+extern xcb_atom_t _XROOTPMAP_ID;
+extern xcb_atom_t ESETROOT_PMAP_ID;
+extern xcb_atom_t _NET_WM_PID;
+
+/* m_tile.c */
+extern bool tilingEnabled;
+
+void TileInsert( node_t* frame );
+void TileRemove( node_t* frame );
+void TileResize( node_t* frame, short width, short height );
+void TileAll( void );
+void FlushLayout( void );
+void TileShutdown( void );
+
+#define IsTiled( n ) ( ( n ) && ( n )->parent && ( n )->parent->type == NODE_GROUP )
+
+/* m_tabs.c */
+#define TAB_START 24
+
+int GetTabCount( node_t* frame );
+node_t* GetTabAtPoint( node_t* frame, short x );
+void SelectTab( node_t* frame, node_t* tab );
+void AddTab( node_t* frame, node_t* client );
+node_t* DetachTab( node_t* client, bool show );
+void TabClosed( node_t* frame );
+void MergeFrames( node_t* target, node_t* src );
+node_t* GetFrameAtTitleBar( short x, short y, node_t* exclude );
+
+/* m_hints.c */
+extern bool csdEnabled;
+
+void GrabMoveButtons( xcb_window_t win );
+void Unframe( node_t* n );
+void Reframe( node_t* n );
+void TrackTopLevel( node_t* n );
+void ReleaseClient( node_t* n );
+void ManageReport( FILE* f );
+void RequestMapHints( node_t* n );
+void RequestNormalHints( node_t* n );
+void ConstrainSize( const node_t* n, unsigned short* width, unsigned short* height );
+void FlushMapHints( void );
+void MapHintsShutdown( void );
+
+/* m_fullscreen.c */
+bool StateHasFullscreen( xcb_get_property_reply_t* reply );
+void SetFullscreen( node_t* n, bool fullscreen );
+void FullscreenMessage( xcb_client_message_event_t* e );
+
+/* m_titles.c */
+extern int titleInterval;
+
+void QueueTitle( node_t* n, xcb_atom_t atom );
+int TitleTimeout( void );
+void FlushTitles( void );
+void TitleReport( FILE* f );
+void TitlesShutdown( void );
+
+/* m_usage.c */
+// room for a whole title and the figures after it
+#define USAGE_LABEL_SIZE 288
+
+extern bool usageEnabled;
+
+void SetupUsage( bool enabled, int interval );
+uint32_t UsagePid( xcb_get_property_reply_t* pid, xcb_get_property_reply_t* machine );
+void UsageWatch( node_t* n );
+void UsageForget( node_t* n );
+int UsageTimeout( void );
+void FlushUsage( void );
+const char* UsageLabel( node_t* n, char* buf, int size );
+void UsageReport( FILE* f );
+void UsageShutdown( void );
+
+/* m_rules.c */
+#define RULE_POSITION ( 1 << 0 )
+#define RULE_SIZE ( 1 << 1 )
+#define RULE_DECORATIONS ( 1 << 2 )
+#define RULE_FOCUS ( 1 << 3 )
+
+// what the matching rules say about a window; set says which fields count
+typedef struct {
+	unsigned int set;
+	bool center;
+	short x, y;
+	unsigned short width, height;
+	bool decorations;
+	bool focus;
+} windowRule_t;
+
+extern bool rulesNeedTitle;
+
+void LoadRules( void );
+bool RulesLoaded( void );
+bool MatchRules( xcb_get_property_reply_t* wmClass, xcb_get_property_reply_t* role, const char* title, windowRule_t* out );
+void RulesShutdown( void );
+
+/* m_text.c */
+extern bool textEnabled;
+
+void SetupText( const char* path, int size, int cacheSize );
+void TextShutdown( void );
+void TextForgetFrame( node_t* frame );
+int TextWidth( const char* s );
+void TextDraw( node_t* frame, short x, short y, const char* s, int maxWidth, bool active );
+void TextReport( FILE* f );
+
+/* m_theme.c */
 typedef enum {
-	NODE_ROOT,
-	NODE_CLIENT,
-	NODE_FRAME,
-	NODE_GROUP,
-} nodeType_t;
-
-struct node_s;
-
-typedef struct nodeList_s {
-	struct node_s** nodes;
-	int max;
-} nodeList_t;
-
-typedef struct node_s {
-	nodeType_t type;
-	xcb_window_t window;
-	char name[256];
-	short x, y, width, height;
-
-	struct node_s* parent;
-	struct nodeList_s children;
-	char parentMapped;
-	
-	clientWindowState_t windowState;
-	clientManagementState_t managementState;
-	//todo: gravity
-} node_t;
\ No newline at end of file
+	SLICE_TITLE_LEFT_ACTIVE,
+	SLICE_TITLE_FILL_ACTIVE,
+	SLICE_TITLE_RIGHT_ACTIVE,
+	SLICE_TITLE_LEFT_INACTIVE,
+	SLICE_TITLE_FILL_INACTIVE,
+	SLICE_TITLE_RIGHT_INACTIVE,
+	SLICE_CLOSE_ACTIVE,
+	SLICE_CLOSE_PRESSED,
+	SLICE_BORDER_ACTIVE,
+	SLICE_BORDER_INACTIVE,
+	THEME_SLICE_COUNT
+} themeSliceId_t;
+
+typedef struct {
+	int width, height;
+	xcb_pixmap_t pixmap;
+} themeSlice_t;
+
+// how the root visual lays out a pixel
+typedef struct {
+	int bpp;
+	int redShift, greenShift, blueShift;
+	int redBits, greenBits, blueBits;
+} pixelFormat_t;
+
+extern bool themeEnabled;
+extern themeSlice_t themeSlices[THEME_SLICE_COUNT];
+
+bool GetPixelFormat( pixelFormat_t* f );
+void ConvertRGBA( const pixelFormat_t* f, const unsigned char* src, unsigned char* dst, int count );
+void PutBands( xcb_drawable_t d, xcb_gcontext_t gc, const unsigned char* mem, int width, int height, int stride );
+void LoadTheme( const char* dir );
+void ThemeShutdown( void );
+void DrawThemedFrame( node_t* frame, bool active, bool pressed );
+void DrawThemedText( node_t* frame, short x, short y, const char* s, int len, xcb_gcontext_t gc );
+
+/* m_wallpaper.c */
+void LoadWallpaper( const char* path, const char* mode );
+void WallpaperShutdown( void );
+
+/* m_errors.c */
+// called when a tracked request fails, with the window it was sent to
+typedef void (*errorCleanup_t)( xcb_window_t window, unsigned char error );
+
+void TrackRequest( xcb_void_cookie_t cookie, xcb_window_t window, const char* what, errorCleanup_t cleanup );
+void RetireRequests( unsigned int sequence );
+void HandleError( xcb_generic_error_t* e );
+void ForgetWindow( xcb_window_t window, unsigned char error );
+void ErrorReport( FILE* f );
+
+/* m_trace.c */
+typedef unsigned long long traceTime_t;
+
+extern bool traceEnabled;
+
+void SetupTrace( const char* path, int count );
+traceTime_t TraceNow( void );
+void TraceSpan( const char* name, traceTime_t start, xcb_window_t window );
+const char* TraceEventName( unsigned char type );
+void TraceWrite( void );
+void TraceShutdown( void );
+
+/* m_switcher.c */
+void SetupSwitcher( void );
+void SwitcherOpen( bool withKeyboard );
+void SwitcherClose( bool choose );
+void SwitcherForget( node_t* n );
+void SwitcherKeyPress( xcb_key_press_event_t* e );
+void SwitcherKeyRelease( xcb_key_release_event_t* e );
+bool SwitcherButtonPress( xcb_button_press_event_t* e );
+void SwitcherExpose( xcb_window_t window );
+bool SwitcherEvent( xcb_generic_event_t* e );
+void SwitcherFlush( void );
+void SwitcherShutdown( void );
+
+/* m_restart.c */
+int SaveState( void );
+int RestoreState( int fd );
@@ -0,0 +1,151 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+
+#include <sulfur/sulfur.h>
+
+#include "m_common.h"
+
+/*
+=============
+Error tracker
+
+Requests sent to client windows are fire and forget, so when a client
+goes away with some of them in flight the server answers with an error
+that arrives in the event queue long after the request was made. Each
+such request is recorded here by sequence number, along with the window
+it was for and what to do if it fails. Events carry the sequence of the
+last request the server had processed, and errors arrive in order, so
+anything older than an incoming event or error can no longer fail and is
+retired. Nothing here ever waits on the server.
+=============
+*/
+
+#define TRACK_MAX 1024
+#define TRACK_LABELS 32
+
+typedef struct {
+	unsigned int sequence;
+	xcb_window_t window;
+	const char* what;
+	errorCleanup_t cleanup;
+} trackedRequest_t;
+
+typedef struct {
+	const char* what;
+	long errors;
+} errorLabel_t;
+
+// a ring, oldest at head
+static trackedRequest_t tracked[TRACK_MAX];
+static int trackHead, trackCount;
+
+static errorLabel_t labels[TRACK_LABELS];
+static long trackedTotal, matchedTotal, untrackedTotal, droppedTotal, cleanupTotal;
+static long codeCounts[256];
+
+static const char* errorNames[] = {
+	"Success", "BadRequest", "BadValue", "BadWindow", "BadPixmap", "BadAtom",
+	"BadCursor", "BadFont", "BadMatch", "BadDrawable", "BadAccess", "BadAlloc",
+	"BadColor", "BadGC", "BadIDChoice", "BadName", "BadLength", "BadImplementation",
+};
+
+static const char* ErrorName( unsigned char code ) {
+	if ( code < sizeof( errorNames ) / sizeof( errorNames[0] ) )
+		return errorNames[code];
+	return "extension error";
+}
+
+// sequence numbers wrap, so compare by difference
+static bool SequenceBefore( unsigned int a, unsigned int b ) {
+	return (int)( a - b ) < 0;
+}
+
+void TrackRequest( xcb_void_cookie_t cookie, xcb_window_t window, const char* what, errorCleanup_t cleanup ) {
+	trackedRequest_t* t;
+
+	// nothing has been heard about the oldest one, but it's almost surely fine
+	if ( trackCount == TRACK_MAX ) {
+		trackHead = ( trackHead + 1 ) % TRACK_MAX;
+		trackCount--;
+		droppedTotal++;
+	}
+	t = &tracked[( trackHead + trackCount ) % TRACK_MAX];
+	t->sequence = cookie.sequence;
+	t->window = window;
+	t->what = what;
+	t->cleanup = cleanup;
+	trackCount++;
+	trackedTotal++;
+}
+
+// everything sent before sequence has been processed without an error
+void RetireRequests( unsigned int sequence ) {
+	while ( trackCount > 0 && SequenceBefore( tracked[trackHead].sequence, sequence ) ) {
+		trackHead = ( trackHead + 1 ) % TRACK_MAX;
+		trackCount--;
+	}
+}
+
+static void CountLabel( const char* what ) {
+	int i;
+
+	for ( i = 0; i < TRACK_LABELS && labels[i].what; i++ ) {
+		if ( labels[i].what == what )
+			break;
+	}
+	if ( i == TRACK_LABELS )
+		return;
+	labels[i].what = what;
+	labels[i].errors++;
+}
+
+void HandleError( xcb_generic_error_t* e ) {
+	trackedRequest_t t;
+
+	codeCounts[e->error_code]++;
+	RetireRequests( e->full_sequence );
+	if ( trackCount == 0 || tracked[trackHead].sequence != e->full_sequence ) {
+		untrackedTotal++;
+		fprintf( stderr, "warning: %s from untracked request %u (opcode %i.%i, resource %x)\n",
+			ErrorName( e->error_code ), e->full_sequence, e->major_code, e->minor_code, e->resource_id );
+		return;
+	}
+
+	t = tracked[trackHead];
+	trackHead = ( trackHead + 1 ) % TRACK_MAX;
+	trackCount--;
+	matchedTotal++;
+	CountLabel( t.what );
+	dbgprintf( 1, "%s from %s on window %x (request %u)\n", ErrorName( e->error_code ), t.what, t.window, t.sequence );
+	if ( t.cleanup ) {
+		cleanupTotal++;
+		t.cleanup( t.window, e->error_code );
+	}
+}
+
+// the usual cleanup: a client that vanished under a request is forgotten
+// without waiting for its DestroyNotify, so nothing more is sent to it
+void ForgetWindow( xcb_window_t window, unsigned char error ) {
+	node_t* n;
+
+	if ( error != XCB_WINDOW )
+		return;
+	n = GetNodeByWindow( window );
+	if ( n && n->type == NODE_CLIENT )
+		QueueDestroy( n );
+}
+
+void ErrorReport( FILE* f ) {
+	int i;
+
+	fprintf( f, "%-10s %10s %10s %10s %10s %10s\n", "x errors", "tracked", "matched", "untracked", "dropped", "cleanups" );
+	fprintf( f, "%-10s %10li %10li %10li %10li %10li\n", "", trackedTotal, matchedTotal, untrackedTotal, droppedTotal, cleanupTotal );
+	for ( i = 0; i < 256; i++ ) {
+		if ( codeCounts[i] )
+			fprintf( f, "%-20s %10li\n", ErrorName( i ), codeCounts[i] );
+	}
+	for ( i = 0; i < TRACK_LABELS && labels[i].what; i++ )
+		fprintf( f, "from %-15s %10li\n", labels[i].what, labels[i].errors );
+}
@@ -0,0 +1,129 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+
+#include <sulfur/sulfur.h>
+
+#include "m_common.h"
+
+/*
+==========
+Fullscreen
+
+A client that asks for _NET_WM_STATE_FULLSCREEN is taken out of its frame
+and put on the root directly, borderless and covering the screen. With
+no frame there's nothing of ours left to draw or hit test over it, and
+the switcher leaves it unredirected so it's shown straight from its own
+buffers. Its geometry before, and whether it had a frame, are kept in its
+node, so leaving fullscreen puts everything back as it was.
+==========
+*/
+
+#define NET_WM_STATE_REMOVE 0
+#define NET_WM_STATE_ADD 1
+#define NET_WM_STATE_TOGGLE 2
+
+bool StateHasFullscreen( xcb_get_property_reply_t* reply ) {
+	xcb_atom_t* atoms;
+	int i, count;
+
+	if ( !reply || reply->format != 32 )
+		return false;
+	atoms = xcb_get_property_value( reply );
+	count = xcb_get_property_value_length( reply ) / 4;
+	for ( i = 0; i < count; i++ ) {
+		if ( atoms[i] == _NET_WM_STATE_FULLSCREEN )
+			return true;
+	}
+	return false;
+}
+
+// fullscreen is the only state we keep, so the property is ours to replace
+static void UpdateStateProperty( node_t* n ) {
+	TrackRequest( xcb_change_property( c, XCB_PROP_MODE_REPLACE, n->window, _NET_WM_STATE, XCB_ATOM_ATOM, 32,
+		n->fullscreen ? 1 : 0, &_NET_WM_STATE_FULLSCREEN ), n->window, "state", ForgetWindow );
+}
+
+static void EnterFullscreen( node_t* n ) {
+	node_t* p = GetParentFrame( n );
+
+	if ( p && GetActiveTab( p ) != n )
+		SelectTab( p, n );
+	n->fullscreen = FULLSCREEN_ON;
+	n->restoreX = p ? p->x : n->x;
+	n->restoreY = p ? p->y : n->y;
+	n->restoreWidth = n->width;
+	n->restoreHeight = n->height;
+	// a tab comes out on its own, and its frame stays with the others
+	if ( p ) {
+		n->fullscreen |= FULLSCREEN_FRAMED;
+		Unframe( n );
+	}
+
+	SwitcherForget( n );
+	ConfigureClient( n, 0, 0, rootNode->width, rootNode->height );
+	RaiseClient( n );
+	dbgprintf( 2, "window %x is fullscreen\n", n->window );
+}
+
+static void LeaveFullscreen( node_t* n ) {
+	node_t* p = NULL;
+
+	if ( n->fullscreen & FULLSCREEN_FRAMED ) {
+		n->x = n->restoreX;
+		n->y = n->restoreY;
+		n->width = n->restoreWidth;
+		n->height = n->restoreHeight;
+		if ( n->parentMapped )
+			n->ignoreUnmap++;
+		Reframe( n );
+		p = GetParentFrame( n );
+	}
+	n->fullscreen = 0;
+
+	ConfigureClient( n, n->restoreX, n->restoreY, n->restoreWidth, n->restoreHeight );
+	if ( p && n->parentMapped ) {
+		xcb_map_window( c, p->window );
+		TileInsert( p );
+	}
+	RaiseClient( n );
+	dbgprintf( 2, "window %x left fullscreen\n", n->window );
+}
+
+void SetFullscreen( node_t* n, bool fullscreen ) {
+	if ( n->type != NODE_CLIENT || fullscreen == ( n->fullscreen != 0 ) )
+		return;
+	if ( n->managementState != STATE_REPARENTED && n->managementState != STATE_UNFRAMED )
+		return;
+	// the frame being dragged may be about to go away
+	if ( wmState != WMSTATE_IDLE )
+		EndDrag();
+
+	if ( fullscreen )
+		EnterFullscreen( n );
+	else
+		LeaveFullscreen( n );
+	UpdateStateProperty( n );
+}
+
+// a _NET_WM_STATE client message names up to two states to change
+void FullscreenMessage( xcb_client_message_event_t* e ) {
+	node_t* n = GetNodeByWindow( e->window );
+
+	if ( !n || e->format != 32 )
+		return;
+	if ( e->data.data32[1] != _NET_WM_STATE_FULLSCREEN && e->data.data32[2] != _NET_WM_STATE_FULLSCREEN )
+		return;
+	switch ( e->data.data32[0] ) {
+		case NET_WM_STATE_REMOVE:
+			SetFullscreen( n, false );
+			break;
+		case NET_WM_STATE_ADD:
+			SetFullscreen( n, true );
+			break;
+		case NET_WM_STATE_TOGGLE:
+			SetFullscreen( n, !n->fullscreen );
+			break;
+	}
+}
@@ -0,0 +1,586 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+
+#include <sulfur/sulfur.h>
+
+#include "m_common.h"
+
+/*
+=============
+Map-time hints
+
+Properties that decide how a client is shown are requested when it maps
+and read back once per event batch, so a map never waits on the server.
+
+A new top-level window is only tracked: most are toolkit leaders,
+clipboard owners and the like that never map. Its frame is made, and
+its buttons grabbed, when it first shows, and it gives the frame up again
+when it's withdrawn. That happens at the end of the batch too, since an
+exiting client's unmap is usually followed by its DestroyNotify, and a
+window that's gone by then needs no reparenting.
+
+Clients that draw their own title bar say so through _MOTIF_WM_HINTS or
+_GTK_FRAME_EXTENTS. Such a client is taken out of its frame and managed on
+the root directly; one that stops doing so gets a frame back on its next
+map. WM_TRANSIENT_FOR puts a dialog in its parent's transient group, and
+_NET_WM_STATE can ask for the client to start out fullscreen.
+When there are window rules, the properties they match on are asked for
+here as well, and a matching rule is applied before the client shows.
+The resource overlay's _NET_WM_PID and WM_CLIENT_MACHINE come along too
+when it's on.
+
+WM_NORMAL_HINTS is read the same way at map, and again whenever it
+changes, and kept on the node. Every size sent to a client is fitted to
+it first, so the client never has to answer with a size of its own.
+=============
+*/
+
+#define MWM_HINTS_DECORATIONS ( 1 << 1 )
+#define MWM_DECOR_ALL ( 1 << 0 )
+#define MWM_DECOR_TITLE ( 1 << 3 )
+
+// WM_SIZE_HINTS flags and the words they cover
+#define P_MIN_SIZE ( 1 << 4 )
+#define P_MAX_SIZE ( 1 << 5 )
+#define P_RESIZE_INC ( 1 << 6 )
+#define P_ASPECT ( 1 << 7 )
+#define P_BASE_SIZE ( 1 << 8 )
+#define SIZE_HINTS_WORDS 18
+
+bool csdEnabled = true;
+
+typedef struct {
+	xcb_window_t window;
+	bool decor; // whether motif and gtk were requested
+	xcb_get_property_cookie_t motif;
+	xcb_get_property_cookie_t gtk;
+	xcb_get_property_cookie_t transient;
+	xcb_get_property_cookie_t state;
+	xcb_get_property_cookie_t normalHints;
+	bool usage; // whether the pid and host were requested, for the overlay
+	xcb_get_property_cookie_t pid;
+	xcb_get_property_cookie_t machine;
+	bool rules; // whether the rule properties were requested
+	xcb_get_property_cookie_t wmClass;
+	xcb_get_property_cookie_t role;
+	xcb_get_property_cookie_t title;
+} pendingMap_t;
+
+static pendingMap_t* pending = NULL;
+static int pendingCount = 0;
+static int pendingMax = 0;
+
+// WM_NORMAL_HINTS changes on clients that are already shown
+typedef struct {
+	xcb_window_t window;
+	xcb_get_property_cookie_t cookie;
+} pendingHints_t;
+
+static pendingHints_t* hintUpdates = NULL;
+static int hintUpdateCount = 0;
+static int hintUpdateMax = 0;
+
+// withdrawn clients waiting to give up their frames
+static xcb_window_t* releases = NULL;
+static int releaseCount = 0;
+static int releaseMax = 0;
+
+// framing at create made one frame per top-level tracked; these say what
+// framing at map makes instead
+static long trackedTotal, framedTotal, unframedTotal, releasedTotal;
+
+// lets a client be moved with the modifier and button 1, and resized with button 3
+void GrabMoveButtons( xcb_window_t win ) {
+	unsigned short mask = XCB_EVENT_MASK_BUTTON_PRESS | XCB_EVENT_MASK_BUTTON_RELEASE | XCB_EVENT_MASK_POINTER_MOTION;
+
+	TrackRequest( xcb_grab_button( c, 0, win, mask, XCB_GRAB_MODE_ASYNC, XCB_GRAB_MODE_ASYNC,
+		XCB_NONE, XCB_NONE, XCB_BUTTON_INDEX_1, DRAG_MODIFIER ), win, "grab", ForgetWindow );
+	TrackRequest( xcb_grab_button( c, 0, win, mask, XCB_GRAB_MODE_ASYNC, XCB_GRAB_MODE_ASYNC,
+		XCB_NONE, XCB_NONE, XCB_BUTTON_INDEX_3, DRAG_MODIFIER ), win, "grab", ForgetWindow );
+}
+
+static bool WantsTitleBar( xcb_get_property_reply_t* motif, xcb_get_property_reply_t* gtk ) {
+	unsigned int* hints;
+	bool title;
+
+	if ( gtk && gtk->format == 32 && xcb_get_property_value_length( gtk ) >= 16 )
+		return false;
+	if ( !motif || motif->format != 32 || xcb_get_property_value_length( motif ) < 12 )
+		return true;
+
+	hints = xcb_get_property_value( motif );
+	if ( ( hints[0] & MWM_HINTS_DECORATIONS ) == 0 )
+		return true;
+	// with MWM_DECOR_ALL set, the other bits list what to leave out
+	title = ( hints[2] & MWM_DECOR_TITLE ) != 0;
+	if ( hints[2] & MWM_DECOR_ALL )
+		title = !title;
+	return title;
+}
+
+// hands a framed client back to the root. the frame goes too, unless
+// other tabs are left in it.
+void Unframe( node_t* n ) {
+	node_t* p = GetParentFrame( n );
+	bool last = GetTabCount( p ) < 2;
+	bool shown = last || p->activeTab == n;
+
+	RemoveNodeFromList( n, &p->children );
+	n->parent = rootNode;
+	n->x = p->x;
+	n->y = p->y;
+	AddNodeToList( n, &rootNode->children );
+
+	// reparenting a mapped window unmaps it on the way
+	if ( n->parentMapped && shown )
+		n->ignoreUnmap++;
+	TrackRequest( xcb_reparent_window( c, n->window, screen->root, n->x, n->y ), n->window, "reparent", ForgetWindow );
+	n->managementState = STATE_UNFRAMED;
+	if ( last ) {
+		p->activeTab = NULL;
+		DestroyNode( p );
+	} else {
+		if ( p->activeTab == n )
+			TabClosed( p );
+		AddNodeToList( p, &redrawList );
+	}
+	dbgprintf( 2, "window %x taken out of its frame\n", n->window );
+}
+
+void Reframe( node_t* n ) {
+	node_t* p;
+
+	RemoveNodeFromList( n, &n->parent->children );
+	p = CreateFrame( n, n->x, n->y );
+	AddNodeToList( n, &p->children );
+	dbgprintf( 2, "window %x given a frame\n", n->window );
+}
+
+void TrackTopLevel( node_t* n ) {
+	n->managementState = STATE_TRACKED;
+	trackedTotal++;
+}
+
+// a tracked window's first map, it gets a frame unless it draws its own
+static void Manage( node_t* n, bool title ) {
+	if ( title ) {
+		// reparenting a mapped window unmaps it on the way
+		if ( n->parentMapped )
+			n->ignoreUnmap++;
+		Reframe( n );
+		framedTotal++;
+	} else {
+		n->managementState = STATE_UNFRAMED;
+		unframedTotal++;
+	}
+	GrabMoveButtons( n->window );
+}
+
+// a withdrawn client goes back to being tracked on the root
+static void Release( node_t* n ) {
+	node_t* p = GetParentFrame( n );
+
+	if ( !p || n->managementState != STATE_REPARENTED )
+		return;
+	Unframe( n );
+	n->managementState = STATE_TRACKED;
+	releasedTotal++;
+}
+
+void ReleaseClient( node_t* n ) {
+	if ( !GetParentFrame( n ) || n->managementState != STATE_REPARENTED )
+		return;
+	if ( releaseCount == releaseMax ) {
+		releaseMax += 4;
+		releases = AcctRealloc( ACCT_LISTS, releases, sizeof( xcb_window_t ) * releaseMax );
+		if ( !releases ) {
+			fprintf( stderr, "failure growing pending release list\n" );
+			Quit( 2 );
+		}
+	}
+	releases[releaseCount++] = n->window;
+}
+
+void ManageReport( FILE* f ) {
+	fprintf( f, "%-10s %10s %10s %10s %10s %10s\n", "top-level", "tracked", "framed", "unframed", "released", "saved" );
+	fprintf( f, "%-10s %10li %10li %10li %10li %10li  (frames not made, against one per top-level)\n", "",
+		trackedTotal, framedTotal, unframedTotal, releasedTotal, trackedTotal - framedTotal );
+}
+
+static void SetTransientFromReply( node_t* n, xcb_get_property_reply_t* reply ) {
+	node_t* parent = NULL;
+
+	if ( reply && reply->format == 32 && xcb_get_property_value_length( reply ) >= 4 )
+		parent = GetNodeByWindow( *(xcb_window_t*)xcb_get_property_value( reply ) );
+	if ( parent && ( parent == n || parent->type != NODE_CLIENT ) )
+		parent = NULL;
+	SetTransientFor( n, parent );
+}
+
+// a size field is a CARD32, and a window is never wider than a short
+static int HintSize( unsigned int v ) {
+	return v > 32767 ? 32767 : (int)v;
+}
+
+static void SetSizeHints( node_t* n, xcb_get_property_reply_t* reply ) {
+	sizeHints_t* h = &n->sizeHints;
+	unsigned int* v;
+
+	memset( h, 0, sizeof( *h ) );
+	if ( !reply || reply->format != 32 || xcb_get_property_value_length( reply ) < SIZE_HINTS_WORDS * 4 )
+		return;
+	v = xcb_get_property_value( reply );
+	if ( v[0] & P_MIN_SIZE ) {
+		h->minWidth = HintSize( v[5] );
+		h->minHeight = HintSize( v[6] );
+	}
+	if ( v[0] & P_MAX_SIZE ) {
+		h->maxWidth = HintSize( v[7] );
+		h->maxHeight = HintSize( v[8] );
+	}
+	if ( v[0] & P_RESIZE_INC ) {
+		h->incWidth = HintSize( v[9] );
+		h->incHeight = HintSize( v[10] );
+	}
+	if ( ( v[0] & P_ASPECT ) && v[12] && v[14] ) {
+		h->minAspectX = v[11];
+		h->minAspectY = v[12];
+		h->maxAspectX = v[13];
+		h->maxAspectY = v[14];
+	}
+	if ( v[0] & P_BASE_SIZE ) {
+		h->baseWidth = HintSize( v[15] );
+		h->baseHeight = HintSize( v[16] );
+	}
+	// each stands in for the other when only one is given
+	if ( !( v[0] & P_BASE_SIZE ) ) {
+		h->baseWidth = h->minWidth;
+		h->baseHeight = h->minHeight;
+	} else if ( !( v[0] & P_MIN_SIZE ) ) {
+		h->minWidth = h->baseWidth;
+		h->minHeight = h->baseHeight;
+	}
+	if ( h->maxWidth > 0 && h->maxWidth < h->minWidth )
+		h->maxWidth = h->minWidth;
+	if ( h->maxHeight > 0 && h->maxHeight < h->minHeight )
+		h->maxHeight = h->minHeight;
+}
+
+// fits a client size to the client's WM_NORMAL_HINTS, as ICCCM 4.1.2.3 asks
+void ConstrainSize( const node_t* n, unsigned short* width, unsigned short* height ) {
+	const sizeHints_t* h = &n->sizeHints;
+	long long w = *width, hh = *height;
+
+	// aspect and increments count from the base size
+	w -= h->baseWidth;
+	hh -= h->baseHeight;
+	if ( w < 1 )
+		w = 1;
+	if ( hh < 1 )
+		hh = 1;
+	if ( h->minAspectY && w * h->minAspectY < hh * h->minAspectX )
+		hh = w * h->minAspectY / h->minAspectX;
+	if ( h->maxAspectY && w * h->maxAspectY > hh * h->maxAspectX )
+		w = hh * h->maxAspectX / h->maxAspectY;
+	if ( h->incWidth > 0 )
+		w -= w % h->incWidth;
+	if ( h->incHeight > 0 )
+		hh -= hh % h->incHeight;
+	w += h->baseWidth;
+	hh += h->baseHeight;
+
+	if ( w < h->minWidth )
+		w = h->minWidth;
+	if ( hh < h->minHeight )
+		hh = h->minHeight;
+	if ( h->maxWidth > 0 && w > h->maxWidth )
+		w = h->maxWidth;
+	if ( h->maxHeight > 0 && hh > h->maxHeight )
+		hh = h->maxHeight;
+	*width = w > 0 ? w : 1;
+	*height = hh > 0 ? hh : 1;
+}
+
+// true if WM_NORMAL_HINTS was asked for again after the map-time request, so
+// the map-time reply is older than what's already been applied
+static bool HintsRefetched( xcb_window_t window, unsigned int sequence ) {
+	int i;
+
+	for ( i = 0; i < hintUpdateCount; i++ ) {
+		if ( hintUpdates[i].window == window )
+			return (int)( hintUpdates[i].cookie.sequence - sequence ) > 0;
+	}
+	return false;
+}
+
+// refetches WM_NORMAL_HINTS after it changes, to be read back with the map hints
+void RequestNormalHints( node_t* n ) {
+	int i;
+
+	if ( n->type != NODE_CLIENT )
+		return;
+	for ( i = 0; i < hintUpdateCount; i++ ) {
+		if ( hintUpdates[i].window == n->window )
+			break;
+	}
+	if ( i < hintUpdateCount ) {
+		// the reply on its way may predate this change
+		xcb_discard_reply( c, hintUpdates[i].cookie.sequence );
+	} else {
+		if ( hintUpdateCount == hintUpdateMax ) {
+			hintUpdateMax += 4;
+			hintUpdates = AcctRealloc( ACCT_LISTS, hintUpdates, sizeof( pendingHints_t ) * hintUpdateMax );
+			if ( !hintUpdates ) {
+				fprintf( stderr, "failure growing pending hints list\n" );
+				Quit( 2 );
+			}
+		}
+		hintUpdates[hintUpdateCount++].window = n->window;
+	}
+	hintUpdates[i].cookie = xcb_get_property( c, 0, n->window, XCB_ATOM_WM_NORMAL_HINTS,
+		XCB_ATOM_WM_SIZE_HINTS, 0, SIZE_HINTS_WORDS );
+}
+
+// shows n once its hints are known
+void RequestMapHints( node_t* n ) {
+	int i;
+
+	// child windows belong to their client and are shown as they are
+	if ( n->type != NODE_CLIENT || ( n->managementState != STATE_REPARENTED &&
+		 n->managementState != STATE_UNFRAMED && n->managementState != STATE_TRACKED ) ) {
+		ShowClient( n );
+		return;
+	}
+	for ( i = 0; i < pendingCount; i++ ) {
+		if ( pending[i].window == n->window )
+			return;
+	}
+	if ( pendingCount == pendingMax ) {
+		pendingMax += 4;
+		pending = AcctRealloc( ACCT_LISTS, pending, sizeof( pendingMap_t ) * pendingMax );
+		if ( !pending ) {
+			fprintf( stderr, "failure growing pending map list\n" );
+			Quit( 2 );
+		}
+	}
+	memset( &pending[pendingCount], 0, sizeof( pendingMap_t ) );
+	pending[pendingCount].window = n->window;
+	pending[pendingCount].decor = csdEnabled;
+	if ( csdEnabled ) {
+		pending[pendingCount].motif = xcb_get_property( c, 0, n->window, _MOTIF_WM_HINTS, XCB_ATOM_ANY, 0, 5 );
+		pending[pendingCount].gtk = xcb_get_property( c, 0, n->window, _GTK_FRAME_EXTENTS, XCB_ATOM_CARDINAL, 0, 4 );
+	}
+	pending[pendingCount].transient = xcb_get_property( c, 0, n->window, XCB_ATOM_WM_TRANSIENT_FOR, XCB_ATOM_WINDOW, 0, 1 );
+	pending[pendingCount].state = xcb_get_property( c, 0, n->window, _NET_WM_STATE, XCB_ATOM_ATOM, 0, 16 );
+	pending[pendingCount].normalHints = xcb_get_property( c, 0, n->window, XCB_ATOM_WM_NORMAL_HINTS,
+		XCB_ATOM_WM_SIZE_HINTS, 0, SIZE_HINTS_WORDS );
+	pending[pendingCount].usage = usageEnabled;
+	if ( usageEnabled ) {
+		pending[pendingCount].pid = xcb_get_property( c, 0, n->window, _NET_WM_PID, XCB_ATOM_CARDINAL, 0, 1 );
+		pending[pendingCount].machine = xcb_get_property( c, 0, n->window, XCB_ATOM_WM_CLIENT_MACHINE, XCB_ATOM_STRING, 0, 64 );
+	}
+	pending[pendingCount].rules = RulesLoaded();
+	if ( pending[pendingCount].rules ) {
+		pending[pendingCount].wmClass = xcb_get_property( c, 0, n->window, XCB_ATOM_WM_CLASS, XCB_ATOM_STRING, 0, 64 );
+		pending[pendingCount].role = xcb_get_property( c, 0, n->window, WM_WINDOW_ROLE, XCB_ATOM_STRING, 0, 64 );
+		// titles otherwise only arrive with a change, so a fresh window has none yet
+		if ( rulesNeedTitle )
+			pending[pendingCount].title = xcb_get_property( c, 0, n->window, XCB_ATOM_WM_NAME, XCB_ATOM_ANY, 0, 64 );
+	}
+	pendingCount++;
+}
+
+// reads the rule properties back and finds what the rules say
+static bool GetRule( pendingMap_t* p, windowRule_t* rule ) {
+	xcb_get_property_reply_t* wmClass = xcb_get_property_reply( c, p->wmClass, NULL );
+	xcb_get_property_reply_t* role = xcb_get_property_reply( c, p->role, NULL );
+	xcb_get_property_reply_t* title = rulesNeedTitle ? xcb_get_property_reply( c, p->title, NULL ) : NULL;
+	char name[256];
+	int len = title ? xcb_get_property_value_length( title ) : 0;
+	bool matched;
+
+	if ( len > 255 )
+		len = 255;
+	memcpy( name, title ? xcb_get_property_value( title ) : "", len );
+	name[len] = '\0';
+	matched = MatchRules( wmClass, role, name, rule );
+	free( wmClass );
+	free( role );
+	free( title );
+	return matched;
+}
+
+static void ApplyRule( node_t* n, const windowRule_t* rule ) {
+	node_t* target = GetParentFrame( n );
+	unsigned short width = n->width, height = n->height;
+	short x, y;
+
+	if ( !( rule->set & ( RULE_POSITION | RULE_SIZE ) ) )
+		return;
+	if ( !target )
+		target = n;
+	if ( rule->set & RULE_SIZE ) {
+		width = rule->width;
+		height = rule->height;
+	}
+	x = target->x;
+	y = target->y;
+	if ( ( rule->set & RULE_POSITION ) && rule->center ) {
+		x = ( rootNode->width - ( target->width - n->width + width ) ) / 2;
+		y = ( rootNode->height - ( target->height - n->height + height ) ) / 2;
+	} else if ( rule->set & RULE_POSITION ) {
+		x = rule->x;
+		y = rule->y;
+	}
+	ConfigureClient( n, x, y, width, height );
+}
+
+// called once per event batch, after the batch's requests have gone out
+void FlushMapHints( void ) {
+	xcb_get_property_reply_t* motif;
+	xcb_get_property_reply_t* gtk;
+	xcb_get_property_reply_t* transient;
+	xcb_get_property_reply_t* state;
+	xcb_get_property_reply_t* normalHints;
+	xcb_get_property_reply_t* pid;
+	xcb_get_property_reply_t* machine;
+	windowRule_t rule;
+	node_t* n,* focused;
+	bool title, fullscreen, fresh;
+	uint32_t localPid;
+	int i;
+
+	// before the maps, so a client withdrawn and shown again in one batch is framed afresh
+	for ( i = 0; i < releaseCount; i++ ) {
+		n = GetNodeByWindow( releases[i] );
+		if ( n )
+			Release( n );
+	}
+	releaseCount = 0;
+
+	// kept until after the maps, which skip their own reply when one of these is newer
+	for ( i = 0; i < hintUpdateCount; i++ ) {
+		normalHints = xcb_get_property_reply( c, hintUpdates[i].cookie, NULL );
+		n = GetNodeByWindow( hintUpdates[i].window );
+		if ( n )
+			SetSizeHints( n, normalHints );
+		free( normalHints );
+	}
+
+	for ( i = 0; i < pendingCount; i++ ) {
+		title = true;
+		if ( pending[i].decor ) {
+			motif = xcb_get_property_reply( c, pending[i].motif, NULL );
+			gtk = xcb_get_property_reply( c, pending[i].gtk, NULL );
+			title = WantsTitleBar( motif, gtk );
+			free( motif );
+			free( gtk );
+		}
+		transient = xcb_get_property_reply( c, pending[i].transient, NULL );
+		state = xcb_get_property_reply( c, pending[i].state, NULL );
+		fullscreen = StateHasFullscreen( state );
+		free( state );
+		normalHints = xcb_get_property_reply( c, pending[i].normalHints, NULL );
+		localPid = 0;
+		if ( pending[i].usage ) {
+			pid = xcb_get_property_reply( c, pending[i].pid, NULL );
+			machine = xcb_get_property_reply( c, pending[i].machine, NULL );
+			localPid = UsagePid( pid, machine );
+			free( pid );
+			free( machine );
+		}
+		memset( &rule, 0, sizeof( rule ) );
+		if ( pending[i].rules )
+			GetRule( &pending[i], &rule );
+
+		// the client may have gone or been withdrawn while we waited
+		n = GetNodeByWindow( pending[i].window );
+		if ( !n || n->windowState != STATE_NORMAL ) {
+			free( transient );
+			free( normalHints );
+			continue;
+		}
+		SetTransientFromReply( n, transient );
+		free( transient );
+		if ( !HintsRefetched( n->window, pending[i].normalHints.sequence ) )
+			SetSizeHints( n, normalHints );
+		free( normalHints );
+		if ( localPid ) {
+			n->pid = localPid;
+			UsageWatch( n );
+		}
+
+		if ( rule.set & RULE_DECORATIONS )
+			title = rule.decorations;
+		// a client that's still fullscreen keeps the frame it had before
+		if ( n->fullscreen && !fullscreen )
+			SetFullscreen( n, false );
+		fresh = ( n->managementState == STATE_TRACKED );
+		if ( fresh ) {
+			// one that's fullscreen from the start isn't framed until it leaves
+			Manage( n, title && !fullscreen );
+		} else if ( !fullscreen ) {
+			if ( !title && n->managementState == STATE_REPARENTED && GetTabCount( GetParentFrame( n ) ) == 1 )
+				Unframe( n );
+			else if ( title && n->managementState == STATE_UNFRAMED )
+				Reframe( n );
+		}
+		// placement is for where a window first shows, not wherever it's been moved since
+		if ( !n->fullscreen && !n->placed )
+			ApplyRule( n, &rule );
+		n->placed = 1;
+		if ( fullscreen ) {
+			SetFullscreen( n, true );
+			if ( fresh && title )
+				n->fullscreen |= FULLSCREEN_FRAMED;
+		}
+
+		// an unfocused window goes in behind the one that has focus
+		focused = windowList.nodes[0];
+		if ( ( rule.set & RULE_FOCUS ) && !rule.focus && focused && focused != n && focused->type == NODE_CLIENT )
+			ShowClientBehind( n, focused );
+		else
+			ShowClient( n );
+	}
+	pendingCount = 0;
+	hintUpdateCount = 0;
+}
+
+void MapHintsShutdown( void ) {
+	int i;
+
+	for ( i = 0; i < pendingCount; i++ ) {
+		if ( pending[i].decor ) {
+			xcb_discard_reply( c, pending[i].motif.sequence );
+			xcb_discard_reply( c, pending[i].gtk.sequence );
+		}
+		xcb_discard_reply( c, pending[i].transient.sequence );
+		xcb_discard_reply( c, pending[i].state.sequence );
+		xcb_discard_reply( c, pending[i].normalHints.sequence );
+		if ( pending[i].usage ) {
+			xcb_discard_reply( c, pending[i].pid.sequence );
+			xcb_discard_reply( c, pending[i].machine.sequence );
+		}
+		if ( pending[i].rules ) {
+			xcb_discard_reply( c, pending[i].wmClass.sequence );
+			xcb_discard_reply( c, pending[i].role.sequence );
+			if ( rulesNeedTitle )
+				xcb_discard_reply( c, pending[i].title.sequence );
+		}
+	}
+	AcctFree( ACCT_LISTS, pending );
+	pending = NULL;
+	pendingCount = pendingMax = 0;
+
+	for ( i = 0; i < hintUpdateCount; i++ )
+		xcb_discard_reply( c, hintUpdates[i].cookie.sequence );
+	AcctFree( ACCT_LISTS, hintUpdates );
+	hintUpdates = NULL;
+	hintUpdateCount = hintUpdateMax = 0;
+
+	AcctFree( ACCT_LISTS, releases );
+	releases = NULL;
+	releaseCount = releaseMax = 0;
+}
@@ -0,0 +1,269 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+#include <sulfur/sulfur.h>
+
+#include "m_common.h"
+
+/*
+=============
+State handoff
+
+Before a restart the node tree is written out to an anonymous file that
+survives exec. The new instance reads it back and adopts the existing
+frames instead of tearing them down and rediscovering everything.
+=============
+*/
+
+#define STATE_MAGIC 0x4e524b4d // "MKRN"
+#define STATE_VERSION 6
+
+typedef struct {
+	unsigned int magic;
+	unsigned int version;
+	unsigned int count;
+} stateHeader_t;
+
+typedef struct {
+	xcb_window_t window;
+	xcb_window_t parent;
+	xcb_window_t transientFor;
+	unsigned char type;
+	unsigned char windowState;
+	unsigned char managementState;
+	unsigned char parentMapped;
+	unsigned char activeTab;
+	unsigned char fullscreen;
+	unsigned char placed;
+	short x, y, width, height;
+	short restoreX, restoreY, restoreWidth, restoreHeight;
+	unsigned int pid;
+	char name[256];
+} stateRecord_t;
+
+static int WriteAll( int fd, const void* buf, size_t len ) {
+	const char* p = buf;
+	ssize_t r;
+
+	while ( len > 0 ) {
+		r = write( fd, p, len );
+		if ( r <= 0 )
+			return -1;
+		p += r;
+		len -= r;
+	}
+	return 0;
+}
+
+static int ReadAll( int fd, void* buf, size_t len ) {
+	char* p = buf;
+	ssize_t r;
+
+	while ( len > 0 ) {
+		r = read( fd, p, len );
+		if ( r <= 0 )
+			return -1;
+		p += r;
+		len -= r;
+	}
+	return 0;
+}
+
+// writes every node in windowList order, so stacking survives the restart.
+// returns a file descriptor positioned at the start of the state, or -1.
+int SaveState( void ) {
+	stateHeader_t header = { STATE_MAGIC, STATE_VERSION, 0 };
+	stateRecord_t* records;
+	node_t* n;
+	int fd, i;
+
+	for ( i = 0; i < windowList.max && windowList.nodes[i] != NULL; i++ )
+		;;
+	records = AcctCalloc( ACCT_RESTART, i ? i : 1, sizeof( stateRecord_t ) );
+	if ( !records )
+		return -1;
+
+	for ( i = 0; i < windowList.max && windowList.nodes[i] != NULL; i++ ) {
+		n = windowList.nodes[i];
+		records[i].window = n->window;
+		records[i].parent = n->parent ? n->parent->window : XCB_NONE;
+		records[i].transientFor = n->transientFor ? n->transientFor->window : XCB_NONE;
+		records[i].type = n->type;
+		records[i].windowState = n->windowState;
+		records[i].managementState = n->managementState;
+		records[i].parentMapped = n->parentMapped;
+		records[i].activeTab = n->parent && n->parent->activeTab == n;
+		records[i].x = n->x;
+		records[i].y = n->y;
+		records[i].width = n->width;
+		records[i].height = n->height;
+		records[i].fullscreen = n->fullscreen;
+		records[i].placed = n->placed;
+		records[i].restoreX = n->restoreX;
+		records[i].restoreY = n->restoreY;
+		records[i].restoreWidth = n->restoreWidth;
+		records[i].restoreHeight = n->restoreHeight;
+		records[i].pid = n->pid;
+		memcpy( records[i].name, n->name, sizeof( records[i].name ) );
+	}
+	header.count = i;
+
+	fd = memfd_create( "makron-state", 0 );
+	if ( fd < 0 ) {
+		FILE* f = tmpfile();
+		if ( f )
+			fd = dup( fileno( f ) );
+		if ( f )
+			fclose( f );
+	}
+	if ( fd < 0 ) {
+		AcctFree( ACCT_RESTART, records );
+		return -1;
+	}
+
+	if ( WriteAll( fd, &header, sizeof( header ) ) < 0 ||
+		 WriteAll( fd, records, sizeof( stateRecord_t ) * header.count ) < 0 ||
+		 lseek( fd, 0, SEEK_SET ) < 0 ) {
+		close( fd );
+		AcctFree( ACCT_RESTART, records );
+		return -1;
+	}
+	AcctFree( ACCT_RESTART, records );
+	dbgprintf( 2, "saved %i nodes for restart\n", header.count );
+	return fd;
+}
+
+// rebuilds the node tree from a saved state. windows that went away while
+// we were restarting are dropped; everything else is adopted as-is.
+int RestoreState( int fd ) {
+	stateHeader_t header;
+	stateRecord_t* records;
+	node_t** nodes;
+	xcb_get_window_attributes_cookie_t* cookies;
+	xcb_get_window_attributes_reply_t* reply;
+	unsigned int v[1];
+	unsigned int i;
+
+	if ( ReadAll( fd, &header, sizeof( header ) ) < 0 ||
+		 header.magic != STATE_MAGIC || header.version != STATE_VERSION ) {
+		close( fd );
+		return -1;
+	}
+	records = AcctCalloc( ACCT_RESTART, header.count ? header.count : 1, sizeof( stateRecord_t ) );
+	nodes = AcctCalloc( ACCT_RESTART, header.count ? header.count : 1, sizeof( node_t* ) );
+	cookies = AcctCalloc( ACCT_RESTART, header.count ? header.count : 1, sizeof( xcb_get_window_attributes_cookie_t ) );
+	if ( !records || !nodes || !cookies ||
+		 ReadAll( fd, records, sizeof( stateRecord_t ) * header.count ) < 0 ) {
+		AcctFree( ACCT_RESTART, records );
+		AcctFree( ACCT_RESTART, nodes );
+		AcctFree( ACCT_RESTART, cookies );
+		close( fd );
+		return -1;
+	}
+	close( fd );
+
+	// one pipelined round trip tells us which windows still exist
+	for ( i = 0; i < header.count; i++ ) {
+		if ( records[i].type != NODE_ROOT )
+			cookies[i] = xcb_get_window_attributes( c, records[i].window );
+	}
+
+	// rebuild windowList from scratch so the saved stacking order is kept
+	windowList.nodes[0] = NULL;
+	for ( i = 0; i < header.count; i++ ) {
+		if ( records[i].type == NODE_ROOT ) {
+			nodes[i] = rootNode;
+		} else {
+			nodes[i] = CreateNode( records[i].type, records[i].window, NULL,
+						records[i].width, records[i].height, records[i].x, records[i].y );
+			if ( !nodes[i] )
+				continue;
+			// frames are ours again, and BackendDestroy counts them out
+			if ( records[i].type == NODE_FRAME )
+				AcctXCreate( ACCT_X_WINDOW );
+			memcpy( nodes[i]->name, records[i].name, sizeof( nodes[i]->name ) );
+			nodes[i]->name[sizeof( nodes[i]->name ) - 1] = '\0';
+			nodes[i]->windowState = records[i].windowState;
+			nodes[i]->managementState = records[i].managementState;
+			nodes[i]->parentMapped = records[i].parentMapped;
+			nodes[i]->fullscreen = records[i].fullscreen;
+			nodes[i]->placed = records[i].placed;
+			nodes[i]->restoreX = records[i].restoreX;
+			nodes[i]->restoreY = records[i].restoreY;
+			nodes[i]->restoreWidth = records[i].restoreWidth;
+			nodes[i]->restoreHeight = records[i].restoreHeight;
+			nodes[i]->pid = records[i].pid;
+		}
+		AddNodeToList( nodes[i], &windowList );
+	}
+	if ( windowList.nodes[0] == NULL )
+		AddNodeToList( rootNode, &windowList );
+
+	for ( i = 0; i < header.count; i++ ) {
+		if ( !nodes[i] || nodes[i] == rootNode )
+			continue;
+		nodes[i]->parent = GetNodeByWindow( records[i].parent );
+		if ( !nodes[i]->parent )
+			nodes[i]->parent = rootNode;
+		AddNodeToList( nodes[i], &nodes[i]->parent->children );
+		if ( records[i].activeTab )
+			nodes[i]->parent->activeTab = nodes[i];
+		if ( records[i].transientFor != XCB_NONE )
+			SetTransientFor( nodes[i], GetNodeByWindow( records[i].transientFor ) );
+	}
+
+	// event selections belong to the old connection, so they must be renewed
+	for ( i = 0; i < header.count; i++ ) {
+		if ( records[i].type == NODE_ROOT )
+			continue;
+		reply = xcb_get_window_attributes_reply( c, cookies[i], NULL );
+		if ( !nodes[i] ) {
+			free( reply );
+			continue;
+		}
+		if ( !reply ) {
+			dbgprintf( 2, "window %x went away during restart\n", records[i].window );
+			nodes[i] = NULL;
+			continue;
+		}
+		free( reply );
+		if ( records[i].type == NODE_FRAME ) {
+			v[0] = FRAME_EVENT_MASK;
+			xcb_change_window_attributes( c, records[i].window, XCB_CW_EVENT_MASK, v );
+		} else if ( records[i].managementState != STATE_NO_REDIRECT ) {
+			v[0] = CLIENT_EVENT_MASK;
+			xcb_change_window_attributes( c, records[i].window, XCB_CW_EVENT_MASK, v );
+			// passive grabs went away with the old connection too
+			if ( records[i].managementState == STATE_REPARENTED || records[i].managementState == STATE_UNFRAMED ) {
+				GrabMoveButtons( records[i].window );
+				// size hints aren't saved, they're cheaper to ask for again
+				RequestNormalHints( nodes[i] );
+				UsageWatch( nodes[i] );
+			}
+		}
+	}
+
+	// drop clients and frames that vanished; this also collapses empty frames
+	for ( i = 0; i < header.count; i++ ) {
+		if ( records[i].type != NODE_ROOT && nodes[i] == NULL ) {
+			node_t* n = GetNodeByWindow( records[i].window );
+			if ( n )
+				QueueDestroy( n );
+		}
+	}
+	ReapNodes();
+
+	if ( windowList.nodes[0] && windowList.nodes[0]->type == NODE_CLIENT )
+		xcb_set_input_focus( c, XCB_INPUT_FOCUS_POINTER_ROOT, windowList.nodes[0]->window, XCB_CURRENT_TIME );
+
+	dbgprintf( 2, "restored %i nodes\n", header.count );
+	AcctFree( ACCT_RESTART, records );
+	AcctFree( ACCT_RESTART, nodes );
+	AcctFree( ACCT_RESTART, cookies );
+	return 0;
+}
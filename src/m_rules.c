@@ -0,0 +1,282 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <fnmatch.h>
+#include <time.h>
+
+#include <sulfur/sulfur.h>
+#include <iniparser/iniparser.h>
+
+#include "m_common.h"
+
+extern dictionary* dict;
+
+/*
+============
+Window rules
+
+Every .makronrc section whose name starts with "rule" is a rule:
+
+	[rule terminal]
+	class = XTerm
+	instance = *
+	role = *
+	title = *vim*
+	position = center		; or x,y
+	size = 800x600
+	decorations = no
+	focus = no
+
+class, instance, role and title are glob patterns matched against
+WM_CLASS, WM_WINDOW_ROLE and the title; any that's left out matches
+everything. The rules are compiled once at load: those with a plain
+class go into a hash table keyed by it, and only the rest are tried one
+by one, so a new window costs a hash lookup plus the few rules that
+can't be hashed. Rules are checked in file order, exact classes before
+patterns, and the first rule to set a field decides it.
+============
+*/
+
+#define RULE_PATTERN 64
+
+typedef struct {
+	char class[RULE_PATTERN];
+	char instance[RULE_PATTERN];
+	char role[RULE_PATTERN];
+	char title[RULE_PATTERN];
+	windowRule_t action;
+	int next;		// the next rule in the same bucket, or -1
+} rule_t;
+
+static rule_t* rules = NULL;
+static int ruleCount = 0;
+
+static int* buckets = NULL;		// the first rule for each class hash, or -1
+static unsigned int bucketMask = 0;
+static int* fallback = NULL;	// rules the table can't hold, in order
+static int fallbackCount = 0;
+
+bool rulesNeedTitle = false;
+
+// FNV-1a
+static unsigned int HashClass( const char* s, int len ) {
+	unsigned int h = 2166136261u;
+	int i;
+
+	for ( i = 0; i < len && s[i]; i++ ) {
+		h ^= (unsigned char)s[i];
+		h *= 16777619u;
+	}
+	return h;
+}
+
+static bool IsPattern( const char* s ) {
+	return !s[0] || strpbrk( s, "*?[" ) != NULL;
+}
+
+static void CopyPattern( char* dst, const char* section, const char* key ) {
+	char name[256];
+	const char* value;
+
+	snprintf( name, sizeof( name ), "%s:%s", section, key );
+	value = iniparser_getstring( dict, name, NULL );
+	dst[0] = '\0';
+	if ( value && strcmp( value, "*" ) )
+		snprintf( dst, RULE_PATTERN, "%s", value );
+}
+
+static void ParseAction( windowRule_t* a, const char* section ) {
+	char name[256];
+	const char* value;
+	int x, y, w, h;
+
+	memset( a, 0, sizeof( *a ) );
+
+	snprintf( name, sizeof( name ), "%s:position", section );
+	value = iniparser_getstring( dict, name, NULL );
+	if ( value && !strcmp( value, "center" ) ) {
+		a->set |= RULE_POSITION;
+		a->center = true;
+	} else if ( value && sscanf( value, "%i,%i", &x, &y ) == 2 ) {
+		a->set |= RULE_POSITION;
+		a->x = x;
+		a->y = y;
+	} else if ( value ) {
+		fprintf( stderr, "%s: position should be center or x,y\n", section );
+	}
+
+	snprintf( name, sizeof( name ), "%s:size", section );
+	value = iniparser_getstring( dict, name, NULL );
+	if ( value && sscanf( value, "%ix%i", &w, &h ) == 2 && w > 0 && h > 0 ) {
+		a->set |= RULE_SIZE;
+		a->width = w;
+		a->height = h;
+	} else if ( value ) {
+		fprintf( stderr, "%s: size should be WIDTHxHEIGHT\n", section );
+	}
+
+	snprintf( name, sizeof( name ), "%s:decorations", section );
+	if ( iniparser_getstring( dict, name, NULL ) ) {
+		a->set |= RULE_DECORATIONS;
+		a->decorations = iniparser_getboolean( dict, name, 1 );
+	}
+	snprintf( name, sizeof( name ), "%s:focus", section );
+	if ( iniparser_getstring( dict, name, NULL ) ) {
+		a->set |= RULE_FOCUS;
+		a->focus = iniparser_getboolean( dict, name, 1 );
+	}
+	snprintf( name, sizeof( name ), "%s:workspace", section );
+	if ( iniparser_getstring( dict, name, NULL ) )
+		fprintf( stderr, "%s: there are no workspaces, ignoring workspace\n", section );
+}
+
+// compiles the rule sections of the loaded config
+void LoadRules( void ) {
+	struct timespec start, end;
+	const char* section;
+	int i, sections, size;
+
+	clock_gettime( CLOCK_MONOTONIC, &start );
+	sections = iniparser_getnsec( dict );
+	for ( i = 0; i < sections; i++ ) {
+		section = iniparser_getsecname( dict, i );
+		if ( section && !strncmp( section, "rule", 4 ) )
+			ruleCount++;
+	}
+	if ( ruleCount == 0 )
+		return;
+
+	for ( size = 8; size < ruleCount * 2; size *= 2 )
+		;;
+	rules = AcctCalloc( ACCT_RULES, ruleCount, sizeof( rule_t ) );
+	buckets = AcctCalloc( ACCT_RULES, size, sizeof( int ) );
+	fallback = AcctCalloc( ACCT_RULES, ruleCount, sizeof( int ) );
+	if ( !rules || !buckets || !fallback ) {
+		fprintf( stderr, "couldn't allocate %i rules\n", ruleCount );
+		RulesShutdown();
+		return;
+	}
+	bucketMask = size - 1;
+	memset( buckets, 0xff, size * sizeof( int ) );
+
+	ruleCount = 0;
+	for ( i = 0; i < sections; i++ ) {
+		rule_t* r = &rules[ruleCount];
+
+		section = iniparser_getsecname( dict, i );
+		if ( !section || strncmp( section, "rule", 4 ) )
+			continue;
+		CopyPattern( r->class, section, "class" );
+		CopyPattern( r->instance, section, "instance" );
+		CopyPattern( r->role, section, "role" );
+		CopyPattern( r->title, section, "title" );
+		ParseAction( &r->action, section );
+		if ( r->title[0] )
+			rulesNeedTitle = true;
+
+		// chained in file order, so walk to the end of the bucket
+		r->next = -1;
+		if ( IsPattern( r->class ) ) {
+			fallback[fallbackCount++] = ruleCount;
+		} else {
+			int* link = &buckets[HashClass( r->class, RULE_PATTERN ) & bucketMask];
+			while ( *link >= 0 )
+				link = &rules[*link].next;
+			*link = ruleCount;
+		}
+		ruleCount++;
+	}
+	clock_gettime( CLOCK_MONOTONIC, &end );
+	dbgprintf( 1, "compiled %i rules, %i by class, in %.3f ms\n", ruleCount, ruleCount - fallbackCount,
+		( end.tv_sec - start.tv_sec ) * 1000.0 + ( end.tv_nsec - start.tv_nsec ) / 1000000.0 );
+}
+
+static bool Matches( const char* pattern, const char* value ) {
+	return !pattern[0] || fnmatch( pattern, value, 0 ) == 0;
+}
+
+static bool RuleMatches( const rule_t* r, const char* class, const char* instance, const char* role, const char* title ) {
+	return Matches( r->class, class ) && Matches( r->instance, instance ) &&
+		Matches( r->role, role ) && Matches( r->title, title );
+}
+
+// fields already set by an earlier rule stay
+static void Merge( windowRule_t* out, const windowRule_t* a ) {
+	unsigned int fresh = a->set & ~out->set;
+
+	if ( fresh & RULE_POSITION ) {
+		out->center = a->center;
+		out->x = a->x;
+		out->y = a->y;
+	}
+	if ( fresh & RULE_SIZE ) {
+		out->width = a->width;
+		out->height = a->height;
+	}
+	if ( fresh & RULE_DECORATIONS )
+		out->decorations = a->decorations;
+	if ( fresh & RULE_FOCUS )
+		out->focus = a->focus;
+	out->set |= fresh;
+}
+
+// copies a string property, which may hold several nul separated strings
+static int PropertyString( xcb_get_property_reply_t* reply, char* dst, int size ) {
+	int len = reply ? xcb_get_property_value_length( reply ) : 0;
+
+	if ( len > size - 1 )
+		len = size - 1;
+	if ( len > 0 )
+		memcpy( dst, xcb_get_property_value( reply ), len );
+	dst[len] = '\0';
+	return len;
+}
+
+// fills out from every rule that matches. returns false if none did.
+bool MatchRules( xcb_get_property_reply_t* wmClass, xcb_get_property_reply_t* role, const char* title, windowRule_t* out ) {
+	char classBuf[256], roleBuf[256];
+	const char* instance = classBuf;
+	const char* class = "";
+	int i, len;
+
+	memset( out, 0, sizeof( *out ) );
+	if ( ruleCount == 0 )
+		return false;
+
+	// WM_CLASS is the instance then the class
+	len = PropertyString( wmClass, classBuf, sizeof( classBuf ) );
+	if ( (int)strlen( classBuf ) < len )
+		class = classBuf + strlen( classBuf ) + 1;
+	PropertyString( role, roleBuf, sizeof( roleBuf ) );
+	if ( !title )
+		title = "";
+
+	for ( i = buckets[HashClass( class, RULE_PATTERN ) & bucketMask]; i >= 0; i = rules[i].next ) {
+		if ( !strcmp( rules[i].class, class ) && RuleMatches( &rules[i], class, instance, roleBuf, title ) )
+			Merge( out, &rules[i].action );
+	}
+	for ( i = 0; i < fallbackCount; i++ ) {
+		if ( RuleMatches( &rules[fallback[i]], class, instance, roleBuf, title ) )
+			Merge( out, &rules[fallback[i]].action );
+	}
+	if ( out->set )
+		dbgprintf( 2, "rules matched class %s instance %s\n", class, instance );
+	return out->set != 0;
+}
+
+bool RulesLoaded( void ) {
+	return ruleCount > 0;
+}
+
+void RulesShutdown( void ) {
+	AcctFree( ACCT_RULES, rules );
+	AcctFree( ACCT_RULES, buckets );
+	AcctFree( ACCT_RULES, fallback );
+	rules = NULL;
+	buckets = NULL;
+	fallback = NULL;
+	ruleCount = fallbackCount = 0;
+	bucketMask = 0;
+	rulesNeedTitle = false;
+}
@@ -0,0 +1,248 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+#if defined( __GNUC__ ) && defined( __x86_64__ )
+#include <immintrin.h>
+#define SCALE_AVX2
+#endif
+
+#include "m_tree.h"
+#include "m_scale.h"
+
+/*
+=============
+Image scaling
+
+Separable bilinear: each source row that's needed is scaled horizontally
+once into a scratch row, and every output row is a blend of two of those.
+Sample positions and weights for the columns are worked out up front, so
+the inner loops are loads, multiplies and adds on 16 bit lanes. Weights
+are in 256ths, which keeps every intermediate inside 16 bits. The row
+blend, where most of the time goes when scaling up, has SSE2 and AVX2
+versions; AVX2 is picked at run time.
+=============
+*/
+
+typedef void (*blendRows_t)( const unsigned char* a, const unsigned char* b, unsigned char* dst, int bytes, int weight );
+
+typedef struct {
+	int* x0; // the left source column for each output column
+	unsigned short* weights; // per output column, the left weight four times then the right
+	int srcWidth;
+	int dstWidth;
+} columns_t;
+
+static blendRows_t blendRows;
+static const char* scalePath;
+
+// where output sample i of count falls among size source samples, in 256ths.
+// centres are lined up, and the pair read never runs off the end.
+static void SamplePosition( int i, int count, int size, int* first, int* weight ) {
+	long long pos = ( ( 2LL * i + 1 ) * size * 256 ) / ( 2LL * count ) - 128;
+
+	if ( pos < 0 )
+		pos = 0;
+	*first = pos >> 8;
+	*weight = pos & 255;
+	if ( size < 2 ) {
+		*first = 0;
+		*weight = 0;
+	} else if ( *first >= size - 1 ) {
+		*first = size - 2;
+		*weight = 256;
+	}
+}
+
+static void ScaleRowScalar( const columns_t* cols, const unsigned char* src, unsigned char* dst ) {
+	const unsigned char* p;
+	int x, k, w0, w1;
+
+	for ( x = 0; x < cols->dstWidth; x++ ) {
+		p = src + cols->x0[x] * 4;
+		w0 = cols->weights[x * 8];
+		w1 = cols->weights[x * 8 + 4];
+		// a one pixel wide source has no right neighbour to read
+		if ( cols->srcWidth < 2 ) {
+			memcpy( dst + x * 4, p, 4 );
+			continue;
+		}
+		for ( k = 0; k < 4; k++ )
+			dst[x * 4 + k] = ( p[k] * w0 + p[k + 4] * w1 ) >> 8;
+	}
+}
+
+#ifdef __SSE2__
+// two output pixels a step, each the weighted sum of an adjacent source pair
+static void ScaleRowSSE2( const columns_t* cols, const unsigned char* src, unsigned char* dst ) {
+	const __m128i zero = _mm_setzero_si128();
+	__m128i a, b, lo, hi, sum;
+	int x = 0;
+
+	if ( cols->srcWidth < 2 ) {
+		ScaleRowScalar( cols, src, dst );
+		return;
+	}
+	for ( ; x + 2 <= cols->dstWidth; x += 2 ) {
+		a = _mm_loadl_epi64( (const __m128i*)( src + cols->x0[x] * 4 ) );
+		b = _mm_loadl_epi64( (const __m128i*)( src + cols->x0[x + 1] * 4 ) );
+		lo = _mm_mullo_epi16( _mm_unpacklo_epi8( a, zero ), _mm_loadu_si128( (const __m128i*)&cols->weights[x * 8] ) );
+		hi = _mm_mullo_epi16( _mm_unpacklo_epi8( b, zero ), _mm_loadu_si128( (const __m128i*)&cols->weights[x * 8 + 8] ) );
+		sum = _mm_add_epi16( _mm_unpacklo_epi64( lo, hi ), _mm_unpackhi_epi64( lo, hi ) );
+		sum = _mm_srli_epi16( sum, 8 );
+		_mm_storel_epi64( (__m128i*)( dst + x * 4 ), _mm_packus_epi16( sum, sum ) );
+	}
+	for ( ; x < cols->dstWidth; x++ ) {
+		const unsigned char* p = src + cols->x0[x] * 4;
+		int k, w0 = cols->weights[x * 8], w1 = cols->weights[x * 8 + 4];
+		for ( k = 0; k < 4; k++ )
+			dst[x * 4 + k] = ( p[k] * w0 + p[k + 4] * w1 ) >> 8;
+	}
+}
+#endif
+
+static void BlendRowsScalar( const unsigned char* a, const unsigned char* b, unsigned char* dst, int bytes, int weight ) {
+	int i;
+
+	for ( i = 0; i < bytes; i++ )
+		dst[i] = ( a[i] * ( 256 - weight ) + b[i] * weight ) >> 8;
+}
+
+#ifdef __SSE2__
+static void BlendRowsSSE2( const unsigned char* a, const unsigned char* b, unsigned char* dst, int bytes, int weight ) {
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i wa = _mm_set1_epi16( 256 - weight );
+	const __m128i wb = _mm_set1_epi16( weight );
+	__m128i va, vb, lo, hi;
+	int i = 0;
+
+	for ( ; i + 16 <= bytes; i += 16 ) {
+		va = _mm_loadu_si128( (const __m128i*)( a + i ) );
+		vb = _mm_loadu_si128( (const __m128i*)( b + i ) );
+		lo = _mm_add_epi16( _mm_mullo_epi16( _mm_unpacklo_epi8( va, zero ), wa ), _mm_mullo_epi16( _mm_unpacklo_epi8( vb, zero ), wb ) );
+		hi = _mm_add_epi16( _mm_mullo_epi16( _mm_unpackhi_epi8( va, zero ), wa ), _mm_mullo_epi16( _mm_unpackhi_epi8( vb, zero ), wb ) );
+		_mm_storeu_si128( (__m128i*)( dst + i ), _mm_packus_epi16( _mm_srli_epi16( lo, 8 ), _mm_srli_epi16( hi, 8 ) ) );
+	}
+	BlendRowsScalar( a + i, b + i, dst + i, bytes - i, weight );
+}
+#endif
+
+#ifdef SCALE_AVX2
+// the unpacks and the pack all work within 128 bit lanes, so bytes keep their order
+__attribute__(( target( "avx2" ) ))
+static void BlendRowsAVX2( const unsigned char* a, const unsigned char* b, unsigned char* dst, int bytes, int weight ) {
+	const __m256i zero = _mm256_setzero_si256();
+	const __m256i wa = _mm256_set1_epi16( 256 - weight );
+	const __m256i wb = _mm256_set1_epi16( weight );
+	__m256i va, vb, lo, hi;
+	int i = 0;
+
+	for ( ; i + 32 <= bytes; i += 32 ) {
+		va = _mm256_loadu_si256( (const __m256i*)( a + i ) );
+		vb = _mm256_loadu_si256( (const __m256i*)( b + i ) );
+		lo = _mm256_add_epi16( _mm256_mullo_epi16( _mm256_unpacklo_epi8( va, zero ), wa ), _mm256_mullo_epi16( _mm256_unpacklo_epi8( vb, zero ), wb ) );
+		hi = _mm256_add_epi16( _mm256_mullo_epi16( _mm256_unpackhi_epi8( va, zero ), wa ), _mm256_mullo_epi16( _mm256_unpackhi_epi8( vb, zero ), wb ) );
+		_mm256_storeu_si256( (__m256i*)( dst + i ), _mm256_packus_epi16( _mm256_srli_epi16( lo, 8 ), _mm256_srli_epi16( hi, 8 ) ) );
+	}
+	BlendRowsScalar( a + i, b + i, dst + i, bytes - i, weight );
+}
+#endif
+
+static void PickPath( void ) {
+	if ( blendRows )
+		return;
+	blendRows = BlendRowsScalar;
+	scalePath = "scalar";
+#ifdef __SSE2__
+	blendRows = BlendRowsSSE2;
+	scalePath = "sse2";
+#endif
+#ifdef SCALE_AVX2
+	__builtin_cpu_init();
+	if ( __builtin_cpu_supports( "avx2" ) ) {
+		blendRows = BlendRowsAVX2;
+		scalePath = "avx2";
+	}
+#endif
+}
+
+const char* ScalePath( void ) {
+	PickPath();
+	return scalePath;
+}
+
+static void ScaleRow( const columns_t* cols, const unsigned char* src, unsigned char* dst ) {
+#ifdef __SSE2__
+	ScaleRowSSE2( cols, src, dst );
+#else
+	ScaleRowScalar( cols, src, dst );
+#endif
+}
+
+bool ScaleImage( const unsigned char* src, int srcWidth, int srcHeight, int srcStride,
+	unsigned char* dst, int dstWidth, int dstHeight, int dstStride ) {
+	columns_t cols;
+	unsigned char* rows[2];
+	int rowSource[2] = { -1, -1 };
+	int x, y, k, y0, weight;
+
+	if ( srcWidth < 1 || srcHeight < 1 || dstWidth < 1 || dstHeight < 1 )
+		return false;
+	PickPath();
+	cols.srcWidth = srcWidth;
+	cols.dstWidth = dstWidth;
+	cols.x0 = AcctCalloc( ACCT_IMAGES, dstWidth, sizeof( int ) );
+	cols.weights = AcctCalloc( ACCT_IMAGES, dstWidth * 8, sizeof( unsigned short ) );
+	rows[0] = AcctCalloc( ACCT_IMAGES, dstWidth, 4 );
+	rows[1] = AcctCalloc( ACCT_IMAGES, dstWidth, 4 );
+	if ( !cols.x0 || !cols.weights || !rows[0] || !rows[1] ) {
+		AcctFree( ACCT_IMAGES, cols.x0 );
+		AcctFree( ACCT_IMAGES, cols.weights );
+		AcctFree( ACCT_IMAGES, rows[0] );
+		AcctFree( ACCT_IMAGES, rows[1] );
+		return false;
+	}
+
+	for ( x = 0; x < dstWidth; x++ ) {
+		SamplePosition( x, dstWidth, srcWidth, &cols.x0[x], &weight );
+		for ( k = 0; k < 4; k++ ) {
+			cols.weights[x * 8 + k] = 256 - weight;
+			cols.weights[x * 8 + 4 + k] = weight;
+		}
+	}
+
+	for ( y = 0; y < dstHeight; y++ ) {
+		SamplePosition( y, dstHeight, srcHeight, &y0, &weight );
+		// going down the image, the lower row of one step is the upper of the next
+		if ( rowSource[1] == y0 ) {
+			unsigned char* t = rows[0];
+			rows[0] = rows[1];
+			rows[1] = t;
+			rowSource[0] = y0;
+			rowSource[1] = -1;
+		}
+		if ( rowSource[0] != y0 ) {
+			ScaleRow( &cols, src + (size_t)y0 * srcStride, rows[0] );
+			rowSource[0] = y0;
+		}
+		if ( weight == 0 || srcHeight < 2 ) {
+			memcpy( dst + (size_t)y * dstStride, rows[0], dstWidth * 4 );
+			continue;
+		}
+		if ( rowSource[1] != y0 + 1 ) {
+			ScaleRow( &cols, src + (size_t)( y0 + 1 ) * srcStride, rows[1] );
+			rowSource[1] = y0 + 1;
+		}
+		blendRows( rows[0], rows[1], dst + (size_t)y * dstStride, dstWidth * 4, weight );
+	}
+
+	AcctFree( ACCT_IMAGES, cols.x0 );
+	AcctFree( ACCT_IMAGES, cols.weights );
+	AcctFree( ACCT_IMAGES, rows[0] );
+	AcctFree( ACCT_IMAGES, rows[1] );
+	return true;
+}
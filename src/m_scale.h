@@ -0,0 +1,22 @@
+/*
+=============
+Image scaling
+
+Bilinear resampling of 8 bit RGBA images, with no dependency on X so it
+can be benchmarked alone.
+=============
+*/
+
+#ifndef M_SCALE_H
+#define M_SCALE_H
+
+#include <stdbool.h>
+
+// strides are in bytes. returns false if the scratch rows can't be allocated.
+bool ScaleImage( const unsigned char* src, int srcWidth, int srcHeight, int srcStride,
+	unsigned char* dst, int dstWidth, int dstHeight, int dstStride );
+
+// the vector path ScaleImage picks on this machine
+const char* ScalePath( void );
+
+#endif
@@ -0,0 +1,624 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+
+#include <sulfur/sulfur.h>
+#include <xcb/render.h>
+#include <xcb/composite.h>
+#include <xcb/damage.h>
+
+#include "m_common.h"
+
+/*
+===============
+Window switcher
+
+The modifier and Tab (or the modifier and the middle button anywhere)
+shows a scaled, live thumbnail of every visible window in stacking
+order. Each window is redirected with Composite the first time it's
+shown, and its contents pixmap is scaled into a thumbnail pixmap with
+an XRender transform, all on the server. A Damage object per window
+marks its thumbnail stale, and only stale thumbnails are scaled again,
+so opening the switcher never reads window contents back. Thumbnails
+are kept while their window is mapped so the next open is just one
+composite per window.
+===============
+*/
+
+#define THUMB_SIZE 192
+#define THUMB_GAP 16
+#define THUMB_BORDER 3
+
+#define XK_Tab 0xff09
+#define XK_Return 0xff0d
+#define XK_Escape 0xff1b
+
+typedef struct {
+	xcb_window_t window;			// a frame, or a client without one
+	xcb_pixmap_t contents;			// named from the redirected window
+	xcb_render_picture_t source;	// on contents, scaled by its transform
+	xcb_pixmap_t pixmap;
+	xcb_render_picture_t picture;
+	xcb_render_pictformat_t format;
+	xcb_damage_damage_t damage;
+	unsigned short sourceWidth, sourceHeight;
+	unsigned short width, height;
+	bool stale;
+} thumb_t;
+
+static thumb_t* thumbs;
+static int thumbCount, thumbMax;
+
+// windows on show, in stacking order
+static xcb_window_t* shown;
+static int shownCount, shownMax;
+static int selected;
+
+static int extensions = 0;		// 1 once checked and present, -1 if missing
+static unsigned char damageEvent;
+static xcb_render_query_pict_formats_reply_t* formats;
+static xcb_render_pictformat_t rootFormat;
+
+static xcb_window_t switcherWindow;
+static xcb_render_picture_t switcherPicture;
+static unsigned short switcherColumns;
+static bool switcherVisible, keyboardGrabbed, needsDraw;
+
+static xcb_keycode_t tabKey, returnKey, escapeKey;
+static xcb_keycode_t modifierKeys[8]; // the keys that set DRAG_MODIFIER
+static int modifierKeyCount;
+
+static xcb_keycode_t FindKeycode( xcb_get_keyboard_mapping_reply_t* reply, xcb_keysym_t sym ) {
+	const xcb_setup_t* setup = xcb_get_setup( c );
+	xcb_keysym_t* syms = xcb_get_keyboard_mapping_keysyms( reply );
+	int i, count = xcb_get_keyboard_mapping_keysyms_length( reply );
+
+	for ( i = 0; i < count; i++ ) {
+		if ( syms[i] == sym )
+			return setup->min_keycode + i / reply->keysyms_per_keycode;
+	}
+	return 0;
+}
+
+// finds the keys that set DRAG_MODIFIER, so releasing shift along the way isn't taken for it
+static void FindModifierKeys( void ) {
+	xcb_get_modifier_mapping_reply_t* reply;
+	xcb_keycode_t* keys;
+	int i, index = 0;
+
+	reply = xcb_get_modifier_mapping_reply( c, xcb_get_modifier_mapping( c ), NULL );
+	if ( !reply )
+		return;
+	while ( !( DRAG_MODIFIER & ( 1 << index ) ) )
+		index++;
+	keys = xcb_get_modifier_mapping_keycodes( reply ) + index * reply->keycodes_per_modifier;
+	modifierKeyCount = 0;
+	for ( i = 0; i < reply->keycodes_per_modifier && modifierKeyCount < 8; i++ ) {
+		if ( keys[i] )
+			modifierKeys[modifierKeyCount++] = keys[i];
+	}
+	free( reply );
+}
+
+// grabs the bindings. the extensions aren't touched until first use.
+void SetupSwitcher( void ) {
+	const xcb_setup_t* setup = xcb_get_setup( c );
+	xcb_get_keyboard_mapping_reply_t* reply;
+
+	xcb_prefetch_extension_data( c, &xcb_composite_id );
+	xcb_prefetch_extension_data( c, &xcb_damage_id );
+
+	reply = xcb_get_keyboard_mapping_reply( c,
+		xcb_get_keyboard_mapping( c, setup->min_keycode, setup->max_keycode - setup->min_keycode + 1 ), NULL );
+	if ( reply ) {
+		tabKey = FindKeycode( reply, XK_Tab );
+		returnKey = FindKeycode( reply, XK_Return );
+		escapeKey = FindKeycode( reply, XK_Escape );
+		free( reply );
+	}
+	FindModifierKeys();
+	if ( tabKey ) {
+		xcb_grab_key( c, 1, screen->root, DRAG_MODIFIER, tabKey, XCB_GRAB_MODE_ASYNC, XCB_GRAB_MODE_ASYNC );
+		xcb_grab_key( c, 1, screen->root, DRAG_MODIFIER | XCB_MOD_MASK_SHIFT, tabKey, XCB_GRAB_MODE_ASYNC, XCB_GRAB_MODE_ASYNC );
+	}
+	xcb_grab_button( c, 0, screen->root, XCB_EVENT_MASK_BUTTON_PRESS, XCB_GRAB_MODE_ASYNC, XCB_GRAB_MODE_ASYNC,
+		XCB_NONE, XCB_NONE, XCB_BUTTON_INDEX_2, DRAG_MODIFIER );
+}
+
+static xcb_render_pictformat_t FindVisualFormat( xcb_visualid_t visual ) {
+	xcb_render_pictscreen_iterator_t si;
+	xcb_render_pictdepth_iterator_t di;
+	xcb_render_pictvisual_iterator_t vi;
+
+	for ( si = xcb_render_query_pict_formats_screens_iterator( formats ); si.rem; xcb_render_pictscreen_next( &si ) ) {
+		for ( di = xcb_render_pictscreen_depths_iterator( si.data ); di.rem; xcb_render_pictdepth_next( &di ) ) {
+			for ( vi = xcb_render_pictdepth_visuals_iterator( di.data ); vi.rem; xcb_render_pictvisual_next( &vi ) ) {
+				if ( vi.data->visual == visual )
+					return vi.data->format;
+			}
+		}
+	}
+	return 0;
+}
+
+// checked the first time the switcher opens, all versions asked at once
+static bool CheckExtensions( void ) {
+	const xcb_query_extension_reply_t* composite,* damage,* render;
+	xcb_composite_query_version_cookie_t compositeCookie;
+	xcb_damage_query_version_cookie_t damageCookie;
+	xcb_render_query_pict_formats_cookie_t formatsCookie;
+	xcb_composite_query_version_reply_t* compositeReply;
+	xcb_damage_query_version_reply_t* damageReply;
+
+	if ( extensions )
+		return extensions > 0;
+	extensions = -1;
+	composite = xcb_get_extension_data( c, &xcb_composite_id );
+	damage = xcb_get_extension_data( c, &xcb_damage_id );
+	render = xcb_get_extension_data( c, &xcb_render_id );
+	if ( !composite || !composite->present || !damage || !damage->present || !render || !render->present ) {
+		fprintf( stderr, "the switcher needs the Composite, Damage and RENDER extensions\n" );
+		return false;
+	}
+
+	compositeCookie = xcb_composite_query_version( c, 0, 2 );
+	damageCookie = xcb_damage_query_version( c, 1, 1 );
+	formatsCookie = xcb_render_query_pict_formats( c );
+	compositeReply = xcb_composite_query_version_reply( c, compositeCookie, NULL );
+	damageReply = xcb_damage_query_version_reply( c, damageCookie, NULL );
+	formats = xcb_render_query_pict_formats_reply( c, formatsCookie, NULL );
+
+	// NameWindowPixmap arrived in 0.2
+	if ( compositeReply && damageReply && formats &&
+		 ( compositeReply->major_version > 0 || compositeReply->minor_version >= 2 ) ) {
+		rootFormat = FindVisualFormat( screen->root_visual );
+		if ( rootFormat ) {
+			damageEvent = damage->first_event + XCB_DAMAGE_NOTIFY;
+			extensions = 1;
+		}
+	}
+	free( compositeReply );
+	free( damageReply );
+	if ( extensions < 0 ) {
+		fprintf( stderr, "the switcher needs Composite 0.2 and a RENDER format for the root visual\n" );
+		free( formats );
+		formats = NULL;
+	}
+	return extensions > 0;
+}
+
+static thumb_t* FindThumb( xcb_window_t window ) {
+	int i;
+
+	for ( i = 0; i < thumbCount; i++ ) {
+		if ( thumbs[i].window == window )
+			return &thumbs[i];
+	}
+	return NULL;
+}
+
+static bool GrowList( void** list, int* max, int count, size_t size ) {
+	void* grown;
+
+	if ( count < *max )
+		return true;
+	grown = AcctRealloc( ACCT_LISTS, *list, ( *max + 4 ) * size );
+	if ( !grown )
+		return false;
+	*list = grown;
+	*max += 4;
+	return true;
+}
+
+// the thumbnail keeps the window's shape, at most THUMB_SIZE on a side
+static void SizeThumb( thumb_t* t, unsigned short width, unsigned short height ) {
+	double scale = (double)THUMB_SIZE / ( width > height ? width : height );
+
+	if ( scale > 1.0 )
+		scale = 1.0;
+	t->sourceWidth = width;
+	t->sourceHeight = height;
+	t->width = width * scale > 1 ? width * scale : 1;
+	t->height = height * scale > 1 ? height * scale : 1;
+}
+
+// names the window's current contents and points the scaled source at it
+static void NameContents( thumb_t* t ) {
+	xcb_render_transform_t scale = {
+		( (long long)t->sourceWidth << 16 ) / t->width, 0, 0,
+		0, ( (long long)t->sourceHeight << 16 ) / t->height, 0,
+		0, 0, 1 << 16
+	};
+
+	t->contents = xcb_generate_id( c );
+	TrackRequest( xcb_composite_name_window_pixmap( c, t->window, t->contents ), t->window, "name pixmap", NULL );
+	AcctXCreate( ACCT_X_PIXMAP );
+	t->source = xcb_generate_id( c );
+	xcb_render_create_picture( c, t->source, t->contents, t->format, 0, NULL );
+	AcctXCreate( ACCT_X_PICTURE );
+	xcb_render_set_picture_transform( c, t->source, scale );
+	xcb_render_set_picture_filter( c, t->source, 8, "bilinear", 0, NULL );
+}
+
+static void FreeContents( thumb_t* t ) {
+	xcb_render_free_picture( c, t->source );
+	xcb_free_pixmap( c, t->contents );
+	AcctXFree( ACCT_X_PICTURE );
+	AcctXFree( ACCT_X_PIXMAP );
+}
+
+static void CreateThumbPixmap( thumb_t* t ) {
+	t->pixmap = xcb_generate_id( c );
+	xcb_create_pixmap( c, screen->root_depth, t->pixmap, screen->root, t->width, t->height );
+	AcctXCreate( ACCT_X_PIXMAP );
+	t->picture = xcb_generate_id( c );
+	xcb_render_create_picture( c, t->picture, t->pixmap, rootFormat, 0, NULL );
+	AcctXCreate( ACCT_X_PICTURE );
+}
+
+static void FreeThumbPixmap( thumb_t* t ) {
+	xcb_render_free_picture( c, t->picture );
+	xcb_free_pixmap( c, t->pixmap );
+	AcctXFree( ACCT_X_PICTURE );
+	AcctXFree( ACCT_X_PIXMAP );
+}
+
+static void CreateThumb( node_t* target, xcb_render_pictformat_t format ) {
+	thumb_t* t;
+
+	if ( !GrowList( (void**)&thumbs, &thumbMax, thumbCount, sizeof( thumb_t ) ) )
+		return;
+	t = &thumbs[thumbCount++];
+	memset( t, 0, sizeof( *t ) );
+	t->window = target->window;
+	t->format = format;
+	SizeThumb( t, target->width, target->height );
+
+	// automatic, so the server still puts it on screen for us
+	TrackRequest( xcb_composite_redirect_window( c, t->window, XCB_COMPOSITE_REDIRECT_AUTOMATIC ), t->window, "redirect", NULL );
+	t->damage = xcb_generate_id( c );
+	xcb_damage_create( c, t->damage, t->window, XCB_DAMAGE_REPORT_LEVEL_NON_EMPTY );
+	NameContents( t );
+	CreateThumbPixmap( t );
+	t->stale = true;
+}
+
+static void DropThumb( thumb_t* t ) {
+	FreeThumbPixmap( t );
+	FreeContents( t );
+	// either may already be gone along with the window
+	TrackRequest( xcb_damage_destroy( c, t->damage ), t->window, "damage destroy", NULL );
+	TrackRequest( xcb_composite_unredirect_window( c, t->window, XCB_COMPOSITE_REDIRECT_AUTOMATIC ), t->window, "unredirect", NULL );
+	*t = thumbs[--thumbCount];
+}
+
+// a window that has gone, or was unmapped and will get new contents
+void SwitcherForget( node_t* n ) {
+	thumb_t* t;
+	int i;
+
+	if ( !n || !( t = FindThumb( n->window ) ) )
+		return;
+	DropThumb( t );
+
+	for ( i = 0; i < shownCount; i++ ) {
+		if ( shown[i] == n->window ) {
+			memmove( &shown[i], &shown[i + 1], ( shownCount - i - 1 ) * sizeof( xcb_window_t ) );
+			shownCount--;
+			if ( selected >= shownCount )
+				selected = shownCount - 1;
+			needsDraw = true;
+			break;
+		}
+	}
+	if ( switcherVisible && shownCount == 0 )
+		SwitcherClose( false );
+}
+
+// the window each visible client is seen through, in stacking order
+static void CollectShown( void ) {
+	node_t* n,* target;
+	int i, j;
+
+	shownCount = 0;
+	for ( i = 0; ( i < windowList.max ) && ( ( n = windowList.nodes[i] ) != NULL ); i++ ) {
+		// fullscreen clients are never redirected
+		if ( n->type != NODE_CLIENT || !n->parentMapped || n->fullscreen )
+			continue;
+		if ( n->managementState != STATE_REPARENTED && n->managementState != STATE_UNFRAMED )
+			continue;
+		target = GetParentFrame( n );
+		if ( target && GetActiveTab( target ) != n )
+			continue;
+		if ( !target )
+			target = n;
+		for ( j = 0; j < shownCount && shown[j] != target->window; j++ )
+			;;
+		if ( j < shownCount )
+			continue;
+		if ( !GrowList( (void**)&shown, &shownMax, shownCount, sizeof( xcb_window_t ) ) )
+			return;
+		shown[shownCount++] = target->window;
+	}
+}
+
+// makes sure every window on show has a thumbnail of its current size.
+// unframed clients can have any visual, so theirs are asked for together.
+static void PrepareThumbs( void ) {
+	xcb_get_window_attributes_cookie_t* cookies;
+	xcb_get_window_attributes_reply_t* reply;
+	xcb_render_pictformat_t format;
+	node_t* n;
+	thumb_t* t;
+	int i;
+
+	cookies = AcctCalloc( ACCT_LISTS, shownCount + 1, sizeof( xcb_get_window_attributes_cookie_t ) );
+	if ( !cookies )
+		return;
+	for ( i = 0; i < shownCount; i++ ) {
+		n = GetNodeByWindow( shown[i] );
+		t = FindThumb( shown[i] );
+		if ( !t && n->type == NODE_CLIENT )
+			cookies[i] = xcb_get_window_attributes( c, shown[i] );
+		if ( !t || ( t->sourceWidth == n->width && t->sourceHeight == n->height ) )
+			continue;
+
+		// a resize gives the window new contents, the redirect stays
+		FreeThumbPixmap( t );
+		FreeContents( t );
+		SizeThumb( t, n->width, n->height );
+		NameContents( t );
+		CreateThumbPixmap( t );
+		t->stale = true;
+	}
+
+	for ( i = 0; i < shownCount; i++ ) {
+		if ( FindThumb( shown[i] ) )
+			continue;
+		n = GetNodeByWindow( shown[i] );
+		format = rootFormat;
+		if ( n->type == NODE_CLIENT ) {
+			reply = xcb_get_window_attributes_reply( c, cookies[i], NULL );
+			format = reply ? FindVisualFormat( reply->visual ) : 0;
+			free( reply );
+		}
+		if ( format )
+			CreateThumb( n, format );
+	}
+	AcctFree( ACCT_LISTS, cookies );
+
+	// anything that couldn't get a thumbnail isn't shown
+	for ( i = 0; i < shownCount; ) {
+		if ( FindThumb( shown[i] ) ) {
+			i++;
+			continue;
+		}
+		memmove( &shown[i], &shown[i + 1], ( shownCount - i - 1 ) * sizeof( xcb_window_t ) );
+		shownCount--;
+	}
+}
+
+static void PlaceSwitcher( void ) {
+	unsigned int v[5];
+	unsigned short rows;
+
+	for ( switcherColumns = 1; switcherColumns * switcherColumns < shownCount; switcherColumns++ )
+		;;
+	rows = ( shownCount + switcherColumns - 1 ) / switcherColumns;
+	v[2] = switcherColumns * ( THUMB_SIZE + THUMB_GAP ) + THUMB_GAP;
+	v[3] = rows * ( THUMB_SIZE + THUMB_GAP ) + THUMB_GAP;
+	v[0] = v[2] < screen->width_in_pixels ? ( screen->width_in_pixels - v[2] ) / 2 : 0;
+	v[1] = v[3] < screen->height_in_pixels ? ( screen->height_in_pixels - v[3] ) / 2 : 0;
+	v[4] = XCB_STACK_MODE_ABOVE;
+
+	if ( !switcherWindow ) {
+		unsigned int attr[3] = { screen->white_pixel, 1, XCB_EVENT_MASK_EXPOSURE | XCB_EVENT_MASK_BUTTON_PRESS };
+		switcherWindow = xcb_generate_id( c );
+		xcb_create_window( c, XCB_COPY_FROM_PARENT, switcherWindow, screen->root, v[0], v[1], v[2], v[3], 0,
+			XCB_WINDOW_CLASS_INPUT_OUTPUT, screen->root_visual,
+			XCB_CW_BACK_PIXEL | XCB_CW_OVERRIDE_REDIRECT | XCB_CW_EVENT_MASK, attr );
+		AcctXCreate( ACCT_X_WINDOW );
+		switcherPicture = xcb_generate_id( c );
+		xcb_render_create_picture( c, switcherPicture, switcherWindow, rootFormat, 0, NULL );
+		AcctXCreate( ACCT_X_PICTURE );
+	}
+	xcb_configure_window( c, switcherWindow, XCB_CONFIG_WINDOW_X | XCB_CONFIG_WINDOW_Y | XCB_CONFIG_WINDOW_WIDTH |
+		XCB_CONFIG_WINDOW_HEIGHT | XCB_CONFIG_WINDOW_STACK_MODE, v );
+	xcb_map_window( c, switcherWindow );
+}
+
+void SwitcherOpen( bool withKeyboard ) {
+	if ( switcherVisible || !CheckExtensions() )
+		return;
+	CollectShown();
+	PrepareThumbs();
+	if ( shownCount == 0 )
+		return;
+
+	PlaceSwitcher();
+	if ( withKeyboard ) {
+		xcb_discard_reply( c, xcb_grab_keyboard( c, 0, screen->root, XCB_CURRENT_TIME,
+			XCB_GRAB_MODE_ASYNC, XCB_GRAB_MODE_ASYNC ).sequence );
+		keyboardGrabbed = true;
+	}
+	// the first is the window already in front
+	selected = shownCount > 1 ? 1 : 0;
+	switcherVisible = true;
+	needsDraw = true;
+}
+
+void SwitcherClose( bool choose ) {
+	node_t* n;
+
+	if ( !switcherVisible )
+		return;
+	xcb_unmap_window( c, switcherWindow );
+	if ( keyboardGrabbed )
+		xcb_ungrab_keyboard( c, XCB_CURRENT_TIME );
+	keyboardGrabbed = false;
+	switcherVisible = false;
+	if ( !choose || selected < 0 || selected >= shownCount )
+		return;
+
+	n = GetNodeByWindow( shown[selected] );
+	if ( n && n->type == NODE_FRAME )
+		n = GetActiveTab( n );
+	if ( n )
+		RaiseClient( n );
+}
+
+static void Select( int step ) {
+	if ( shownCount == 0 )
+		return;
+	selected = ( selected + step + shownCount ) % shownCount;
+	needsDraw = true;
+}
+
+void SwitcherKeyPress( xcb_key_press_event_t* e ) {
+	if ( e->detail == tabKey && !switcherVisible )
+		SwitcherOpen( true );
+	else if ( e->detail == tabKey )
+		Select( ( e->state & XCB_MOD_MASK_SHIFT ) ? -1 : 1 );
+	else if ( e->detail == escapeKey )
+		SwitcherClose( false );
+	else if ( e->detail == returnKey )
+		SwitcherClose( true );
+}
+
+// letting go of the modifier picks the selection. the state is from before
+// the release, so a release without the bit means it went up unseen.
+void SwitcherKeyRelease( xcb_key_release_event_t* e ) {
+	int i;
+
+	if ( !keyboardGrabbed )
+		return;
+	if ( !( e->state & DRAG_MODIFIER ) ) {
+		SwitcherClose( true );
+		return;
+	}
+	for ( i = 0; i < modifierKeyCount; i++ ) {
+		if ( e->detail == modifierKeys[i] ) {
+			SwitcherClose( true );
+			return;
+		}
+	}
+}
+
+static void CellOrigin( int i, short* x, short* y ) {
+	*x = THUMB_GAP + ( i % switcherColumns ) * ( THUMB_SIZE + THUMB_GAP );
+	*y = THUMB_GAP + ( i / switcherColumns ) * ( THUMB_SIZE + THUMB_GAP );
+}
+
+// returns true if the press was the switcher's
+bool SwitcherButtonPress( xcb_button_press_event_t* e ) {
+	short x, y;
+	int i;
+
+	if ( switcherVisible && e->event == switcherWindow ) {
+		for ( i = 0; i < shownCount; i++ ) {
+			CellOrigin( i, &x, &y );
+			if ( e->event_x >= x && e->event_x < x + THUMB_SIZE && e->event_y >= y && e->event_y < y + THUMB_SIZE ) {
+				selected = i;
+				SwitcherClose( true );
+				return true;
+			}
+		}
+		return true;
+	}
+	if ( e->event == screen->root && e->detail == XCB_BUTTON_INDEX_2 && ( e->state & DRAG_MODIFIER ) ) {
+		if ( switcherVisible )
+			SwitcherClose( false );
+		else
+			SwitcherOpen( false );
+		return true;
+	}
+	return false;
+}
+
+void SwitcherExpose( xcb_window_t window ) {
+	if ( window == switcherWindow && switcherWindow )
+		needsDraw = true;
+}
+
+// returns true if the event was a damage notify
+bool SwitcherEvent( xcb_generic_event_t* e ) {
+	xcb_damage_notify_event_t* damage = (xcb_damage_notify_event_t*)e;
+	int i;
+
+	if ( extensions <= 0 || ( e->response_type & ~0x80 ) != damageEvent )
+		return false;
+	// no more notifies come until the damage is subtracted after scaling
+	for ( i = 0; i < thumbCount; i++ ) {
+		if ( thumbs[i].damage == damage->damage ) {
+			thumbs[i].stale = true;
+			needsDraw = needsDraw || switcherVisible;
+			break;
+		}
+	}
+	return true;
+}
+
+// scales whatever changed and redraws the switcher, once per batch
+void SwitcherFlush( void ) {
+	xcb_render_color_t background = { 0xcccc, 0xcccc, 0xcccc, 0xffff };
+	xcb_render_color_t highlight = { 0x0000, 0x0000, 0x0000, 0xffff };
+	xcb_rectangle_t r;
+	thumb_t* t;
+	short x, y;
+	int i;
+
+	if ( !switcherVisible || !needsDraw )
+		return;
+	for ( i = 0; i < shownCount; i++ ) {
+		t = FindThumb( shown[i] );
+		if ( !t->stale )
+			continue;
+		xcb_render_composite( c, XCB_RENDER_PICT_OP_SRC, t->source, XCB_NONE, t->picture,
+			0, 0, 0, 0, 0, 0, t->width, t->height );
+		xcb_damage_subtract( c, t->damage, XCB_NONE, XCB_NONE );
+		t->stale = false;
+	}
+
+	r.x = r.y = 0;
+	r.width = switcherColumns * ( THUMB_SIZE + THUMB_GAP ) + THUMB_GAP;
+	r.height = ( ( shownCount + switcherColumns - 1 ) / switcherColumns ) * ( THUMB_SIZE + THUMB_GAP ) + THUMB_GAP;
+	xcb_render_fill_rectangles( c, XCB_RENDER_PICT_OP_SRC, switcherPicture, background, 1, &r );
+	for ( i = 0; i < shownCount; i++ ) {
+		t = FindThumb( shown[i] );
+		CellOrigin( i, &x, &y );
+		x += ( THUMB_SIZE - t->width ) / 2;
+		y += ( THUMB_SIZE - t->height ) / 2;
+		if ( i == selected ) {
+			r.x = x - THUMB_BORDER;
+			r.y = y - THUMB_BORDER;
+			r.width = t->width + THUMB_BORDER * 2;
+			r.height = t->height + THUMB_BORDER * 2;
+			xcb_render_fill_rectangles( c, XCB_RENDER_PICT_OP_SRC, switcherPicture, highlight, 1, &r );
+		}
+		xcb_render_composite( c, XCB_RENDER_PICT_OP_SRC, t->picture, XCB_NONE, switcherPicture,
+			0, 0, 0, 0, x, y, t->width, t->height );
+	}
+	needsDraw = false;
+}
+
+void SwitcherShutdown( void ) {
+	SwitcherClose( false );
+	while ( thumbCount > 0 )
+		DropThumb( &thumbs[0] );
+	if ( switcherWindow ) {
+		xcb_render_free_picture( c, switcherPicture );
+		xcb_destroy_window( c, switcherWindow );
+		AcctXFree( ACCT_X_PICTURE );
+		AcctXFree( ACCT_X_WINDOW );
+		switcherWindow = 0;
+	}
+	AcctFree( ACCT_LISTS, thumbs );
+	AcctFree( ACCT_LISTS, shown );
+	thumbs = NULL;
+	shown = NULL;
+	thumbMax = shownMax = shownCount = 0;
+	free( formats );
+	formats = NULL;
+	extensions = 0;
+}
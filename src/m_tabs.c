@@ -0,0 +1,185 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+
+#include <sulfur/sulfur.h>
+
+#include "m_common.h"
+
+/*
+=============
+Tabbed frames
+
+A frame can hold several clients. Only the active tab is mapped; the rest
+stay reparented into the frame but unmapped, at the frame's size, so that
+switching tabs is just a map and an unmap. Unmaps we cause ourselves are
+counted in ignoreUnmap so DoUnmapNotify doesn't mistake them for the
+client withdrawing.
+=============
+*/
+
+int GetTabCount( node_t* frame ) {
+	int i;
+
+	if ( !frame || frame->type != NODE_FRAME )
+		return 0;
+	for ( i = 0; ( i < frame->children.max ) && ( frame->children.nodes[i] != NULL ); i++ )
+		;;
+	return i;
+}
+
+// must agree with the cell layout in DrawTabs
+node_t* GetTabAtPoint( node_t* frame, short x ) {
+	int count = GetTabCount( frame );
+	int span = frame ? frame->width - TAB_START - 4 : 0;
+	int i;
+
+	if ( count < 1 || span < count || x < TAB_START )
+		return NULL;
+	i = ( x - TAB_START ) / ( span / count );
+	if ( i >= count )
+		return NULL;
+	return frame->children.nodes[i];
+}
+
+void SelectTab( node_t* frame, node_t* tab ) {
+	node_t* old = GetActiveTab( frame );
+
+	if ( !tab || tab == old || tab->parent != frame )
+		return;
+
+	// map before unmapping so the frame background never shows through
+	TrackRequest( xcb_map_window( c, tab->window ), tab->window, "map", ForgetWindow );
+	if ( old ) {
+		old->ignoreUnmap++;
+		TrackRequest( xcb_unmap_window( c, old->window ), old->window, "unmap", ForgetWindow );
+	}
+	frame->activeTab = tab;
+
+	// focus follows the tab, but the frame keeps its place in the stack
+	if ( old && windowList.nodes[0] == old ) {
+		MoveNodeToFront( tab, &windowList );
+		TrackRequest( xcb_set_input_focus( c, XCB_INPUT_FOCUS_POINTER_ROOT, tab->window, XCB_CURRENT_TIME ), tab->window, "focus", ForgetWindow );
+	}
+	AddNodeToList( frame, &redrawList );
+}
+
+// the active tab went away; show whichever one is left
+void TabClosed( node_t* frame ) {
+	frame->activeTab = frame->children.nodes[0];
+	if ( frame->activeTab ) {
+		TrackRequest( xcb_map_window( c, frame->activeTab->window ), frame->activeTab->window, "map", ForgetWindow );
+		AddNodeToList( frame, &redrawList );
+	}
+}
+
+void AddTab( node_t* frame, node_t* client ) {
+	node_t* src = GetParentFrame( client );
+	node_t* old = GetActiveTab( frame );
+	bool wasShown;
+
+	if ( !frame || !client || !src || src == frame || client->type != NODE_CLIENT )
+		return;
+	wasShown = ( GetActiveTab( src ) == client );
+
+	RemoveNodeFromList( client, &src->children );
+	if ( src->activeTab == client )
+		src->activeTab = NULL;
+
+	// DoReparentNotify configures the client from these
+	client->parent = frame;
+	client->x = frame->x;
+	client->y = frame->y;
+	if ( old ) {
+		client->width = old->width;
+		client->height = old->height;
+	}
+	AddNodeToList( client, &frame->children );
+
+	// reparenting a mapped window unmaps it on the way
+	if ( wasShown )
+		client->ignoreUnmap++;
+	TrackRequest( xcb_reparent_window( c, client->window, frame->window, BORDER_SIZE_LEFT, BORDER_SIZE_TOP ), client->window, "reparent", ForgetWindow );
+	if ( !wasShown )
+		TrackRequest( xcb_map_window( c, client->window ), client->window, "map", ForgetWindow );
+	if ( old ) {
+		old->ignoreUnmap++;
+		TrackRequest( xcb_unmap_window( c, old->window ), old->window, "unmap", ForgetWindow );
+	}
+	frame->activeTab = client;
+	AddNodeToList( frame, &redrawList );
+
+	if ( src->children.nodes[0] == NULL ) {
+		DestroyNode( src );
+	} else if ( wasShown ) {
+		TabClosed( src );
+	}
+}
+
+// moves every client of src into frame, keeping src's shown client in front
+void MergeFrames( node_t* frame, node_t* src ) {
+	node_t* shown = GetActiveTab( src );
+	int i;
+
+	if ( !frame || !src || frame == src || !shown )
+		return;
+
+	for ( i = 0; ( i < src->children.max ) && ( src->children.nodes[i] != NULL ); ) {
+		if ( src->children.nodes[i] == shown ) {
+			i++;
+			continue;
+		}
+		AddTab( frame, src->children.nodes[i] );
+	}
+	AddTab( frame, shown );
+	RaiseClient( shown );
+}
+
+node_t* DetachTab( node_t* client, bool show ) {
+	node_t* src = GetParentFrame( client );
+	node_t* frame;
+	bool mapped;
+
+	if ( !src || GetTabCount( src ) < 2 )
+		return src;
+	mapped = ( GetActiveTab( src ) == client ) && ( client->windowState == STATE_NORMAL );
+
+	RemoveNodeFromList( client, &src->children );
+	if ( src->activeTab == client )
+		TabClosed( src );
+	AddNodeToList( src, &redrawList );
+
+	client->x = src->x + 20;
+	client->y = src->y + 20;
+	if ( mapped )
+		client->ignoreUnmap++;
+	frame = CreateFrame( client, client->x, client->y );
+	AddNodeToList( client, &frame->children );
+	if ( show ) {
+		if ( !mapped )
+			TrackRequest( xcb_map_window( c, client->window ), client->window, "map", ForgetWindow );
+		xcb_map_window( c, frame->window );
+		TileInsert( frame );
+		RaiseClient( client );
+	}
+	return frame;
+}
+
+// finds the topmost frame whose title bar is under the given root position
+node_t* GetFrameAtTitleBar( short x, short y, node_t* exclude ) {
+	node_t* n;
+	node_t* f;
+	int i;
+
+	for ( i = 0; ( i < windowList.max ) && ( ( n = windowList.nodes[i] ) != NULL ); i++ ) {
+		if ( n->type != NODE_CLIENT || n->windowState != STATE_NORMAL )
+			continue;
+		f = GetParentFrame( n );
+		if ( !f || f == exclude || GetActiveTab( f ) != n )
+			continue;
+		if ( x >= f->x && x < f->x + f->width && y >= f->y && y < f->y + BORDER_SIZE_TOP )
+			return f;
+	}
+	return NULL;
+}
@@ -0,0 +1,375 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+
+#include <sulfur/sulfur.h>
+#include <xcb/render.h>
+
+#include <ft2build.h>
+#include FT_FREETYPE_H
+
+#include "m_common.h"
+
+/*
+=============
+Title text
+
+When a TrueType font is configured, titles are drawn through XRender
+instead of the core font. Glyphs are rasterized with FreeType the first
+time a character is drawn and uploaded into a GlyphSet on the server;
+after that, drawing a title is a single CompositeGlyphs request.
+
+The cache is set associative, TEXT_CACHE_WAYS glyphs to a set, and evicts
+the least recently used glyph of a set when it fills up. Glyph ids on the
+server are cache slots, so an evicted id is simply uploaded again. A glyph
+still waiting to be drawn is never evicted; the text so far is sent first.
+=============
+*/
+
+#define TEXT_CACHE_WAYS 4
+#define TEXT_MAX_GLYPHS 255 // per CompositeGlyphs element, and names are no longer
+
+typedef struct {
+	unsigned int codepoint; // 0 when the slot is empty
+	unsigned int lastUsed;
+	short advance;
+} glyphSlot_t;
+
+// a CompositeGlyphs element header, followed by its glyph ids
+typedef struct {
+	unsigned char count;
+	unsigned char pad[3];
+	short dx, dy;
+} glyphElt_t;
+
+bool textEnabled = false;
+
+static FT_Library ftLibrary;
+static FT_Face ftFace;
+static xcb_render_glyphset_t glyphSet;
+static xcb_render_pictformat_t a8Format;
+static xcb_render_pictformat_t windowFormat;
+static xcb_render_picture_t textFill[2]; // inactive, active
+
+static glyphSlot_t* slots;
+static int setCount;
+static unsigned int useClock;
+static long cacheHits, cacheMisses, cacheEvictions;
+
+#define REPLACEMENT_CHAR 0xfffd
+
+// decodes one character, reading invalid UTF-8 as Latin-1 since WM_NAME is.
+// codepoint 0 marks an empty cache slot, so it's never returned.
+static unsigned int NextCodepoint( const unsigned char** s ) {
+	// the smallest codepoint each sequence length may encode
+	static const unsigned int minimum[5] = { 0, 0, 0x80, 0x800, 0x10000 };
+	const unsigned char* p = *s;
+	unsigned int cp;
+	int i, len;
+
+	if ( p[0] < 0x80 ) {
+		len = 1;
+		cp = p[0];
+	} else if ( ( p[0] & 0xe0 ) == 0xc0 ) {
+		len = 2;
+		cp = p[0] & 0x1f;
+	} else if ( ( p[0] & 0xf0 ) == 0xe0 ) {
+		len = 3;
+		cp = p[0] & 0x0f;
+	} else if ( ( p[0] & 0xf8 ) == 0xf0 ) {
+		len = 4;
+		cp = p[0] & 0x07;
+	} else {
+		*s = p + 1;
+		return p[0];
+	}
+	for ( i = 1; i < len; i++ ) {
+		if ( ( p[i] & 0xc0 ) != 0x80 ) {
+			*s = p + 1;
+			return p[0];
+		}
+		cp = ( cp << 6 ) | ( p[i] & 0x3f );
+	}
+	*s = p + len;
+	// overlong forms, surrogates and anything past unicode are well formed but not valid
+	if ( cp == 0 || cp < minimum[len] || ( cp >= 0xd800 && cp <= 0xdfff ) || cp > 0x10ffff )
+		return REPLACEMENT_CHAR;
+	return cp;
+}
+
+// a glyph that draws nothing and takes no room, for one that couldn't be made
+static void UploadEmptyGlyph( unsigned int id, glyphSlot_t* slot ) {
+	xcb_render_glyphinfo_t info;
+
+	memset( &info, 0, sizeof( info ) );
+	slot->advance = 0;
+	xcb_render_add_glyphs( c, glyphSet, 1, &id, &info, 0, NULL );
+}
+
+static void UploadGlyph( unsigned int id, glyphSlot_t* slot ) {
+	FT_GlyphSlot g;
+	xcb_render_glyphinfo_t info;
+	unsigned char* data;
+	int stride, row;
+
+	if ( FT_Load_Char( ftFace, slot->codepoint, FT_LOAD_RENDER | FT_LOAD_TARGET_LIGHT ) != 0 ) {
+		UploadEmptyGlyph( id, slot );
+		return;
+	}
+	g = ftFace->glyph;
+
+	info.width = g->bitmap.width;
+	info.height = g->bitmap.rows;
+	info.x = -g->bitmap_left;
+	info.y = g->bitmap_top;
+	info.x_off = g->advance.x >> 6;
+	info.y_off = 0;
+	slot->advance = info.x_off;
+
+	// A8 glyph rows are padded to four bytes on the wire
+	stride = ( info.width + 3 ) & ~3;
+	data = AcctCalloc( ACCT_TEXT, stride * info.height + 1, 1 );
+	if ( !data ) {
+		UploadEmptyGlyph( id, slot );
+		return;
+	}
+	for ( row = 0; row < info.height; row++ )
+		memcpy( data + row * stride, g->bitmap.buffer + row * g->bitmap.pitch, info.width );
+	xcb_render_add_glyphs( c, glyphSet, 1, &id, &info, stride * info.height, data );
+	AcctFree( ACCT_TEXT, data );
+}
+
+// returns the glyph id for a character, uploading it on a miss. returns 0
+// if that would evict a glyph used since the clock read pinned.
+static unsigned int GetGlyph( unsigned int cp, unsigned int pinned, short* advance ) {
+	glyphSlot_t* set = &slots[( ( cp * 2654435761u ) >> 8 ) % setCount * TEXT_CACHE_WAYS];
+	glyphSlot_t* victim = &set[0];
+	unsigned int id;
+	int i;
+
+	useClock++;
+	for ( i = 0; i < TEXT_CACHE_WAYS; i++ ) {
+		if ( set[i].codepoint == cp ) {
+			set[i].lastUsed = useClock;
+			cacheHits++;
+			*advance = set[i].advance;
+			return set - slots + i + 1;
+		}
+		if ( set[i].lastUsed < victim->lastUsed )
+			victim = &set[i];
+	}
+
+	if ( victim->codepoint != 0 && victim->lastUsed > pinned )
+		return 0;
+	cacheMisses++;
+	id = victim - slots + 1;
+	if ( victim->codepoint != 0 ) {
+		xcb_render_free_glyphs( c, glyphSet, 1, &id );
+		cacheEvictions++;
+	}
+	victim->codepoint = cp;
+	victim->lastUsed = useClock;
+	UploadGlyph( id, victim );
+	*advance = victim->advance;
+	return id;
+}
+
+static bool FindFormats( void ) {
+	xcb_render_query_pict_formats_reply_t* reply;
+	xcb_render_pictforminfo_iterator_t fi;
+	xcb_render_pictscreen_iterator_t si;
+	xcb_render_pictdepth_iterator_t di;
+	xcb_render_pictvisual_iterator_t vi;
+
+	reply = xcb_render_query_pict_formats_reply( c, xcb_render_query_pict_formats( c ), NULL );
+	if ( !reply )
+		return false;
+
+	a8Format = windowFormat = 0;
+	for ( fi = xcb_render_query_pict_formats_formats_iterator( reply ); fi.rem; xcb_render_pictforminfo_next( &fi ) ) {
+		if ( fi.data->type == XCB_RENDER_PICT_TYPE_DIRECT && fi.data->depth == 8 &&
+			 fi.data->direct.alpha_mask == 0xff && fi.data->direct.red_mask == 0 ) {
+			a8Format = fi.data->id;
+			break;
+		}
+	}
+	for ( si = xcb_render_query_pict_formats_screens_iterator( reply ); si.rem && !windowFormat; xcb_render_pictscreen_next( &si ) ) {
+		for ( di = xcb_render_pictscreen_depths_iterator( si.data ); di.rem && !windowFormat; xcb_render_pictdepth_next( &di ) ) {
+			for ( vi = xcb_render_pictdepth_visuals_iterator( di.data ); vi.rem; xcb_render_pictvisual_next( &vi ) ) {
+				if ( vi.data->visual == screen->root_visual ) {
+					windowFormat = vi.data->format;
+					break;
+				}
+			}
+		}
+	}
+	free( reply );
+	return a8Format && windowFormat;
+}
+
+// a solid fill in the colour a core drawing pixel shows as
+static xcb_render_picture_t CreateFill( const xcb_rgb_t* rgb ) {
+	xcb_render_color_t color = { 0, 0, 0, 0xffff };
+	xcb_render_picture_t fill = xcb_generate_id( c );
+
+	if ( rgb ) {
+		color.red = rgb->red;
+		color.green = rgb->green;
+		color.blue = rgb->blue;
+	}
+
+	xcb_render_create_solid_fill( c, fill, color );
+	AcctXCreate( ACCT_X_PICTURE );
+	return fill;
+}
+
+// loads the configured font. leaves textEnabled off, and titles on the
+// core font, if there is no font or the server lacks RENDER.
+void SetupText( const char* path, int size, int cacheSize ) {
+	const xcb_query_extension_reply_t* ext;
+	xcb_query_colors_cookie_t colorsCookie;
+	xcb_query_colors_reply_t* colors;
+	xcb_rgb_t* rgb;
+	uint32_t pixels[2];
+
+	if ( !path || !path[0] )
+		return;
+	ext = xcb_get_extension_data( c, &xcb_render_id );
+	if ( !ext || !ext->present ) {
+		fprintf( stderr, "no RENDER extension, using the core font for titles\n" );
+		return;
+	}
+	if ( FT_Init_FreeType( &ftLibrary ) != 0 )
+		return;
+	if ( FT_New_Face( ftLibrary, path, 0, &ftFace ) != 0 || FT_Set_Pixel_Sizes( ftFace, 0, size ) != 0 ) {
+		fprintf( stderr, "couldn't load font %s\n", path );
+		FT_Done_FreeType( ftLibrary );
+		return;
+	}
+	if ( !FindFormats() ) {
+		FT_Done_Face( ftFace );
+		FT_Done_FreeType( ftLibrary );
+		return;
+	}
+
+	setCount = ( cacheSize + TEXT_CACHE_WAYS - 1 ) / TEXT_CACHE_WAYS;
+	if ( setCount < 1 )
+		setCount = 1;
+	slots = AcctCalloc( ACCT_TEXT, setCount * TEXT_CACHE_WAYS, sizeof( glyphSlot_t ) );
+	if ( !slots ) {
+		FT_Done_Face( ftFace );
+		FT_Done_FreeType( ftLibrary );
+		return;
+	}
+
+	// the same colours the core font titles are drawn in, inactive then active
+	pixels[0] = colorDarkGrey;
+	pixels[1] = colorBlack;
+	colorsCookie = xcb_query_colors( c, screen->default_colormap, 2, pixels );
+
+	glyphSet = xcb_generate_id( c );
+	xcb_render_create_glyph_set( c, glyphSet, a8Format );
+	AcctXCreate( ACCT_X_GLYPHSET );
+	colors = xcb_query_colors_reply( c, colorsCookie, NULL );
+	rgb = colors && xcb_query_colors_colors_length( colors ) == 2 ? xcb_query_colors_colors( colors ) : NULL;
+	textFill[0] = CreateFill( rgb ? &rgb[0] : NULL );
+	textFill[1] = CreateFill( rgb ? &rgb[1] : NULL );
+	free( colors );
+	textEnabled = true;
+	dbgprintf( 1, "drawing titles with %s at %ipx, %i glyph cache\n", path, size, setCount * TEXT_CACHE_WAYS );
+}
+
+void TextShutdown( void ) {
+	if ( !textEnabled )
+		return;
+	xcb_render_free_picture( c, textFill[0] );
+	xcb_render_free_picture( c, textFill[1] );
+	AcctXFree( ACCT_X_PICTURE );
+	AcctXFree( ACCT_X_PICTURE );
+	xcb_render_free_glyph_set( c, glyphSet );
+	AcctXFree( ACCT_X_GLYPHSET );
+	AcctFree( ACCT_TEXT, slots );
+	slots = NULL;
+	FT_Done_Face( ftFace );
+	FT_Done_FreeType( ftLibrary );
+	textEnabled = false;
+}
+
+// frames keep their picture until they are destroyed
+void TextForgetFrame( node_t* frame ) {
+	if ( !frame->picture )
+		return;
+	xcb_render_free_picture( c, frame->picture );
+	AcctXFree( ACCT_X_PICTURE );
+	frame->picture = 0;
+}
+
+int TextWidth( const char* s ) {
+	const unsigned char* p = (const unsigned char*)s;
+	short advance;
+	int width = 0;
+
+	while ( *p ) {
+		GetGlyph( NextCodepoint( &p ), ~0u, &advance );
+		width += advance;
+	}
+	return width;
+}
+
+static void SendGlyphs( node_t* frame, short x, short y, unsigned char* buf, int count, bool active ) {
+	glyphElt_t* elt = (glyphElt_t*)buf;
+
+	if ( count == 0 )
+		return;
+	memset( elt, 0, sizeof( glyphElt_t ) );
+	elt->count = count;
+	elt->dx = x;
+	elt->dy = y;
+	xcb_render_composite_glyphs_32( c, XCB_RENDER_PICT_OP_OVER, textFill[active ? 1 : 0], frame->picture,
+		a8Format, glyphSet, 0, 0, sizeof( glyphElt_t ) + count * 4, buf );
+}
+
+// draws s with its baseline at x, y, stopping before it gets wider than maxWidth
+void TextDraw( node_t* frame, short x, short y, const char* s, int maxWidth, bool active ) {
+	const unsigned char* p = (const unsigned char*)s;
+	unsigned char buf[sizeof( glyphElt_t ) + TEXT_MAX_GLYPHS * 4];
+	unsigned int* ids = (unsigned int*)( buf + sizeof( glyphElt_t ) );
+	unsigned int cp, id, pinned = useClock;
+	short advance;
+	int count = 0, width = 0, sent = 0;
+
+	if ( !frame->picture ) {
+		frame->picture = xcb_generate_id( c );
+		xcb_render_create_picture( c, frame->picture, frame->window, windowFormat, 0, NULL );
+		AcctXCreate( ACCT_X_PICTURE );
+	}
+
+	while ( *p && count < TEXT_MAX_GLYPHS ) {
+		cp = NextCodepoint( &p );
+		id = GetGlyph( cp, pinned, &advance );
+		if ( id == 0 ) {
+			// the set is full of glyphs this title still needs, so draw those first
+			SendGlyphs( frame, x + sent, y, buf, count, active );
+			sent = width;
+			count = 0;
+			pinned = useClock;
+			id = GetGlyph( cp, pinned, &advance );
+		}
+		if ( width + advance > maxWidth )
+			break;
+		width += advance;
+		ids[count++] = id;
+	}
+	SendGlyphs( frame, x + sent, y, buf, count, active );
+}
+
+void TextReport( FILE* f ) {
+	long lookups = cacheHits + cacheMisses;
+
+	if ( !textEnabled )
+		return;
+	fprintf( f, "%-10s %10s %10s %10s\n", "glyphs", "hits", "misses", "evictions" );
+	fprintf( f, "%-10s %10li %10li %10li  (%.1f%% hit)\n", "", cacheHits, cacheMisses, cacheEvictions,
+		lookups ? cacheHits * 100.0 / lookups : 0.0 );
+}
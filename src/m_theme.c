@@ -0,0 +1,440 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/ipc.h>
+#include <sys/shm.h>
+
+#include <sulfur/sulfur.h>
+#include <xcb/shm.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include "m_common.h"
+
+/*
+=============
+Image themes
+
+A theme is a directory of PAM images (P7, RGB or RGB_ALPHA, maxval 255),
+one per slice, named after the entries in sliceNames. Every file is
+mapped rather than read, converted straight into one shared memory
+segment in the root visual's pixel format, and uploaded to a pixmap per
+slice with MIT-SHM. Without MIT-SHM the slices are sent with put_image.
+Either way this happens once, at load; drawing a frame is only copies and
+tiled fills from those pixmaps.
+
+Slices are opaque, any alpha channel is ignored.
+=============
+*/
+
+#define THEME_MAX_PATH 512
+
+static const char* sliceNames[THEME_SLICE_COUNT] = {
+	"title-left-active",
+	"title-fill-active",
+	"title-right-active",
+	"title-left-inactive",
+	"title-fill-inactive",
+	"title-right-inactive",
+	"close-active",
+	"close-pressed",
+	"border-active",
+	"border-inactive",
+};
+
+typedef struct {
+	const unsigned char* map; // the whole file
+	size_t mapSize;
+	const unsigned char* pixels;
+	int channels;
+} sliceFile_t;
+
+bool themeEnabled = false;
+themeSlice_t themeSlices[THEME_SLICE_COUNT];
+static xcb_gcontext_t themeGc;
+
+static int MaskShift( unsigned int mask ) {
+	int i;
+	for ( i = 0; i < 32 && !( mask & ( 1u << i ) ); i++ )
+		;;
+	return i;
+}
+
+static int MaskBits( unsigned int mask ) {
+	int i;
+	for ( i = 0; mask; mask &= mask - 1 )
+		i++;
+	return i;
+}
+
+bool GetPixelFormat( pixelFormat_t* f ) {
+	const xcb_setup_t* setup = xcb_get_setup( c );
+	xcb_format_iterator_t fi;
+	xcb_depth_iterator_t di;
+	xcb_visualtype_iterator_t vi;
+	xcb_visualtype_t* visual = NULL;
+
+	// pixels are written in host order
+	if ( setup->image_byte_order != XCB_IMAGE_ORDER_LSB_FIRST )
+		return false;
+	f->bpp = 0;
+	for ( fi = xcb_setup_pixmap_formats_iterator( setup ); fi.rem; xcb_format_next( &fi ) ) {
+		if ( fi.data->depth == screen->root_depth )
+			f->bpp = fi.data->bits_per_pixel;
+	}
+	for ( di = xcb_screen_allowed_depths_iterator( screen ); di.rem && !visual; xcb_depth_next( &di ) ) {
+		for ( vi = xcb_depth_visuals_iterator( di.data ); vi.rem; xcb_visualtype_next( &vi ) ) {
+			if ( vi.data->visual_id == screen->root_visual ) {
+				visual = vi.data;
+				break;
+			}
+		}
+	}
+	if ( !visual || ( f->bpp != 32 && f->bpp != 16 ) )
+		return false;
+	f->redShift = MaskShift( visual->red_mask );
+	f->greenShift = MaskShift( visual->green_mask );
+	f->blueShift = MaskShift( visual->blue_mask );
+	f->redBits = MaskBits( visual->red_mask );
+	f->greenBits = MaskBits( visual->green_mask );
+	f->blueBits = MaskBits( visual->blue_mask );
+	return f->redBits <= 8 && f->greenBits <= 8 && f->blueBits <= 8;
+}
+
+// reads the PAM header in place. the pixels stay in the mapping.
+static bool ParsePam( sliceFile_t* s, int* width, int* height ) {
+	char header[256];
+	char* line,* save;
+	const unsigned char* end;
+	int depth = 0, maxval = 0;
+	size_t len;
+
+	*width = *height = 0;
+	end = memmem( s->map, s->mapSize < sizeof( header ) ? s->mapSize : sizeof( header ), "ENDHDR\n", 7 );
+	if ( !end || s->mapSize < 3 || memcmp( s->map, "P7\n", 3 ) )
+		return false;
+	len = end - s->map;
+	memcpy( header, s->map, len );
+	header[len] = '\0';
+
+	for ( line = strtok_r( header, "\n", &save ); line; line = strtok_r( NULL, "\n", &save ) ) {
+		sscanf( line, "WIDTH %i", width );
+		sscanf( line, "HEIGHT %i", height );
+		sscanf( line, "DEPTH %i", &depth );
+		sscanf( line, "MAXVAL %i", &maxval );
+	}
+	s->pixels = end + 7;
+	s->channels = depth;
+	if ( *width <= 0 || *height <= 0 || *width > 4096 || *height > 4096 || maxval != 255 || ( depth != 3 && depth != 4 ) )
+		return false;
+	return (size_t)( s->pixels - s->map ) + (size_t)*width * *height * depth <= s->mapSize;
+}
+
+static bool MapSlice( const char* dir, int i, sliceFile_t* s ) {
+	char path[THEME_MAX_PATH];
+	struct stat st;
+	int fd;
+
+	snprintf( path, sizeof( path ), "%s/%s.pam", dir, sliceNames[i] );
+	fd = open( path, O_RDONLY );
+	if ( fd < 0 ) {
+		fprintf( stderr, "theme is missing %s\n", path );
+		return false;
+	}
+	if ( fstat( fd, &st ) < 0 || st.st_size == 0 ) {
+		close( fd );
+		return false;
+	}
+	s->mapSize = st.st_size;
+	s->map = mmap( NULL, s->mapSize, PROT_READ, MAP_PRIVATE, fd, 0 );
+	close( fd );
+	if ( s->map == MAP_FAILED ) {
+		s->map = NULL;
+		return false;
+	}
+	if ( !ParsePam( s, &themeSlices[i].width, &themeSlices[i].height ) ) {
+		fprintf( stderr, "%s is not an 8 bit RGB or RGB_ALPHA PAM image\n", path );
+		return false;
+	}
+	return true;
+}
+
+static unsigned int PackPixel( const pixelFormat_t* f, unsigned int r, unsigned int g, unsigned int b ) {
+	return ( ( r >> ( 8 - f->redBits ) ) << f->redShift ) |
+		   ( ( g >> ( 8 - f->greenBits ) ) << f->greenShift ) |
+		   ( ( b >> ( 8 - f->blueBits ) ) << f->blueShift );
+}
+
+// converts count RGBA pixels to 32 bit pixels. both are little endian, so
+// a source pixel read as a word is 0xAABBGGRR.
+static void ConvertRGBA32( const pixelFormat_t* f, const unsigned char* src, unsigned int* dst, int count ) {
+	int i = 0;
+#ifdef __SSE2__
+	// every channel is 8 bits here, so each is a mask and a shift
+	if ( f->redBits == 8 && f->greenBits == 8 && f->blueBits == 8 ) {
+		const __m128i byte = _mm_set1_epi32( 0xff );
+		const __m128i rs = _mm_cvtsi32_si128( f->redShift );
+		const __m128i gs = _mm_cvtsi32_si128( f->greenShift );
+		const __m128i bs = _mm_cvtsi32_si128( f->blueShift );
+		__m128i p, r, g, b;
+
+		for ( ; i + 4 <= count; i += 4 ) {
+			p = _mm_loadu_si128( (const __m128i*)( src + i * 4 ) );
+			r = _mm_and_si128( p, byte );
+			g = _mm_and_si128( _mm_srli_epi32( p, 8 ), byte );
+			b = _mm_and_si128( _mm_srli_epi32( p, 16 ), byte );
+			p = _mm_or_si128( _mm_or_si128( _mm_sll_epi32( r, rs ), _mm_sll_epi32( g, gs ) ), _mm_sll_epi32( b, bs ) );
+			_mm_storeu_si128( (__m128i*)( dst + i ), p );
+		}
+	}
+#endif
+	for ( ; i < count; i++ )
+		dst[i] = PackPixel( f, src[i * 4], src[i * 4 + 1], src[i * 4 + 2] );
+}
+
+// converts count RGBA pixels to the root visual's format. dst may be src,
+// since no pixel is written before it's been read.
+void ConvertRGBA( const pixelFormat_t* f, const unsigned char* src, unsigned char* dst, int count ) {
+	unsigned short* dst16 = (unsigned short*)dst;
+	int i;
+
+	if ( f->bpp == 32 ) {
+		ConvertRGBA32( f, src, (unsigned int*)dst, count );
+		return;
+	}
+	for ( i = 0; i < count; i++, src += 4 )
+		dst16[i] = PackPixel( f, src[0], src[1], src[2] );
+}
+
+// without MIT-SHM an image goes in bands that each fit in one request
+void PutBands( xcb_drawable_t d, xcb_gcontext_t gc, const unsigned char* mem, int width, int height, int stride ) {
+	size_t max = xcb_get_maximum_request_length( c ) * 4 - 64;
+	int y, rows = max / stride;
+
+	if ( rows < 1 )
+		rows = 1;
+	for ( y = 0; y < height; y += rows ) {
+		if ( rows > height - y )
+			rows = height - y;
+		xcb_put_image( c, XCB_IMAGE_FORMAT_Z_PIXMAP, d, gc, width, rows, 0, y, 0,
+			screen->root_depth, rows * stride, mem + (size_t)y * stride );
+	}
+}
+
+// the server pads every Z pixmap scanline to 32 bits, which matters at 16 bpp
+static int SliceStride( const pixelFormat_t* f, int width ) {
+	return ( width * f->bpp / 8 + 3 ) & ~3;
+}
+
+static void ConvertRow( const pixelFormat_t* f, const unsigned char* src, int channels, int count, unsigned char* dst ) {
+	unsigned short* dst16 = (unsigned short*)dst;
+	unsigned int* dst32 = (unsigned int*)dst;
+	int i;
+
+	if ( channels == 4 ) {
+		ConvertRGBA( f, src, dst, count );
+	} else if ( f->bpp == 32 ) {
+		for ( i = 0; i < count; i++ )
+			dst32[i] = PackPixel( f, src[i * 3], src[i * 3 + 1], src[i * 3 + 2] );
+	} else {
+		for ( i = 0; i < count; i++, src += channels )
+			dst16[i] = PackPixel( f, src[0], src[1], src[2] );
+	}
+}
+
+// converts slice i into dst, a row at a time at the padded stride
+static void ConvertSlice( const pixelFormat_t* f, const sliceFile_t* s, int i, unsigned char* dst ) {
+	const unsigned char* src = s->pixels;
+	int width = themeSlices[i].width, stride = SliceStride( f, width );
+	int y;
+
+	for ( y = 0; y < themeSlices[i].height; y++ )
+		ConvertRow( f, src + (size_t)y * width * s->channels, s->channels, width, dst + (size_t)y * stride );
+}
+
+// sends every slice out of one shared segment. returns false if MIT-SHM
+// isn't usable, so the caller can fall back to put_image.
+static bool UploadShm( const pixelFormat_t* f, sliceFile_t* files, const unsigned int* offsets, size_t size ) {
+	const xcb_query_extension_reply_t* ext = xcb_get_extension_data( c, &xcb_shm_id );
+	xcb_generic_error_t* error;
+	xcb_shm_seg_t seg;
+	unsigned char* mem;
+	int id, i;
+
+	if ( !ext || !ext->present )
+		return false;
+	id = shmget( IPC_PRIVATE, size, IPC_CREAT | 0600 );
+	if ( id < 0 )
+		return false;
+	mem = shmat( id, NULL, 0 );
+	if ( mem == (void*)-1 ) {
+		shmctl( id, IPC_RMID, NULL );
+		return false;
+	}
+
+	seg = xcb_generate_id( c );
+	error = xcb_request_check( c, xcb_shm_attach_checked( c, seg, id, 1 ) );
+	// the segment lives on until the server detaches as well
+	shmctl( id, IPC_RMID, NULL );
+	if ( error ) {
+		free( error );
+		shmdt( mem );
+		return false;
+	}
+
+	for ( i = 0; i < THEME_SLICE_COUNT; i++ ) {
+		ConvertSlice( f, &files[i], i, mem + offsets[i] );
+		xcb_shm_put_image( c, themeSlices[i].pixmap, themeGc, SliceStride( f, themeSlices[i].width ) * 8 / f->bpp, themeSlices[i].height,
+			0, 0, themeSlices[i].width, themeSlices[i].height, 0, 0,
+			screen->root_depth, XCB_IMAGE_FORMAT_Z_PIXMAP, 0, seg, offsets[i] );
+	}
+	xcb_shm_detach( c, seg );
+	shmdt( mem );
+	return true;
+}
+
+static bool UploadPutImage( const pixelFormat_t* f, sliceFile_t* files, const unsigned int* offsets, size_t size ) {
+	unsigned char* mem = malloc( size );
+	int i;
+
+	if ( !mem )
+		return false;
+	for ( i = 0; i < THEME_SLICE_COUNT; i++ ) {
+		ConvertSlice( f, &files[i], i, mem + offsets[i] );
+		PutBands( themeSlices[i].pixmap, themeGc, mem + offsets[i], themeSlices[i].width, themeSlices[i].height,
+			SliceStride( f, themeSlices[i].width ) );
+	}
+	free( mem );
+	return true;
+}
+
+void ThemeShutdown( void ) {
+	int i;
+
+	for ( i = 0; i < THEME_SLICE_COUNT; i++ ) {
+		if ( themeSlices[i].pixmap ) {
+			xcb_free_pixmap( c, themeSlices[i].pixmap );
+			AcctXFree( ACCT_X_PIXMAP );
+		}
+	}
+	memset( themeSlices, 0, sizeof( themeSlices ) );
+	if ( themeGc ) {
+		xcb_free_gc( c, themeGc );
+		AcctXFree( ACCT_X_GC );
+		themeGc = 0;
+	}
+	themeEnabled = false;
+}
+
+// loads the theme in dir. on any failure the built-in look stays.
+void LoadTheme( const char* dir ) {
+	sliceFile_t files[THEME_SLICE_COUNT];
+	unsigned int offsets[THEME_SLICE_COUNT];
+	pixelFormat_t format;
+	struct timespec start, end;
+	size_t size = 0;
+	bool ok = true;
+	int i;
+
+	if ( !dir || !dir[0] )
+		return;
+	if ( !GetPixelFormat( &format ) ) {
+		fprintf( stderr, "themes aren't supported on this visual\n" );
+		return;
+	}
+	clock_gettime( CLOCK_MONOTONIC, &start );
+
+	memset( files, 0, sizeof( files ) );
+	for ( i = 0; i < THEME_SLICE_COUNT && ok; i++ ) {
+		ok = MapSlice( dir, i, &files[i] );
+		offsets[i] = size;
+		// padded rows keep every slice word aligned in the segment too
+		size += (size_t)SliceStride( &format, themeSlices[i].width ) * themeSlices[i].height;
+	}
+
+	if ( ok ) {
+		themeGc = xcb_generate_id( c );
+		xcb_create_gc( c, themeGc, screen->root, 0, NULL );
+		AcctXCreate( ACCT_X_GC );
+		for ( i = 0; i < THEME_SLICE_COUNT; i++ ) {
+			themeSlices[i].pixmap = xcb_generate_id( c );
+			xcb_create_pixmap( c, screen->root_depth, themeSlices[i].pixmap, screen->root,
+				themeSlices[i].width, themeSlices[i].height );
+			AcctXCreate( ACCT_X_PIXMAP );
+		}
+		if ( !UploadShm( &format, files, offsets, size ) )
+			ok = UploadPutImage( &format, files, offsets, size );
+	}
+
+	for ( i = 0; i < THEME_SLICE_COUNT; i++ ) {
+		if ( files[i].map )
+			munmap( (void*)files[i].map, files[i].mapSize );
+	}
+	if ( !ok ) {
+		ThemeShutdown();
+		return;
+	}
+	themeEnabled = true;
+
+	clock_gettime( CLOCK_MONOTONIC, &end );
+	dbgprintf( 1, "loaded theme %s, %i slices, %zu bytes in %.3f ms\n", dir, THEME_SLICE_COUNT, size,
+		( end.tv_sec - start.tv_sec ) * 1000.0 + ( end.tv_nsec - start.tv_nsec ) / 1000000.0 );
+}
+
+static void CopySlice( xcb_window_t win, themeSliceId_t id, short x, short y ) {
+	xcb_copy_area( c, themeSlices[id].pixmap, win, themeGc, 0, 0, x, y, themeSlices[id].width, themeSlices[id].height );
+}
+
+static void TileSlice( xcb_window_t win, themeSliceId_t id, short x, short y, unsigned short w, unsigned short h ) {
+	unsigned int v[4] = { XCB_FILL_STYLE_TILED, themeSlices[id].pixmap, x, y };
+	xcb_rectangle_t r = { x, y, w, h };
+
+	if ( w == 0 || h == 0 )
+		return;
+	xcb_change_gc( c, themeGc, XCB_GC_FILL_STYLE | XCB_GC_TILE | XCB_GC_TILE_STIPPLE_ORIGIN_X | XCB_GC_TILE_STIPPLE_ORIGIN_Y, v );
+	xcb_poly_fill_rectangle( c, win, themeGc, 1, &r );
+}
+
+// draws everything but the title text
+void DrawThemedFrame( node_t* frame, bool active, bool pressed ) {
+	themeSliceId_t left = active ? SLICE_TITLE_LEFT_ACTIVE : SLICE_TITLE_LEFT_INACTIVE;
+	themeSliceId_t fill = active ? SLICE_TITLE_FILL_ACTIVE : SLICE_TITLE_FILL_INACTIVE;
+	themeSliceId_t right = active ? SLICE_TITLE_RIGHT_ACTIVE : SLICE_TITLE_RIGHT_INACTIVE;
+	themeSliceId_t border = active ? SLICE_BORDER_ACTIVE : SLICE_BORDER_INACTIVE;
+	themeSliceId_t close = pressed ? SLICE_CLOSE_PRESSED : SLICE_CLOSE_ACTIVE;
+	short fillEnd = frame->width - themeSlices[right].width;
+	xcb_window_t win = frame->window;
+
+	CopySlice( win, left, 0, 0 );
+	if ( fillEnd > themeSlices[left].width )
+		TileSlice( win, fill, themeSlices[left].width, 0, fillEnd - themeSlices[left].width, BORDER_SIZE_TOP );
+	CopySlice( win, right, fillEnd, 0 );
+
+	TileSlice( win, border, 0, BORDER_SIZE_TOP, BORDER_SIZE_LEFT, frame->height - BORDER_SIZE_TOP );
+	TileSlice( win, border, frame->width - BORDER_SIZE_RIGHT, BORDER_SIZE_TOP, BORDER_SIZE_RIGHT, frame->height - BORDER_SIZE_TOP );
+	TileSlice( win, border, 0, frame->height - BORDER_SIZE_BOTTOM, frame->width, BORDER_SIZE_BOTTOM );
+
+	if ( active )
+		CopySlice( win, close, 8, ( BORDER_SIZE_TOP - themeSlices[close].height ) / 2 );
+}
+
+// like image_text_8, but leaves the title bar image behind the text alone
+void DrawThemedText( node_t* frame, short x, short y, const char* s, int len, xcb_gcontext_t gc ) {
+	unsigned char items[2 + 254];
+
+	if ( len > 254 )
+		len = 254;
+	items[0] = len;
+	items[1] = 0;
+	memcpy( items + 2, s, len );
+	xcb_poly_text_8( c, frame->window, gc, x, y, len + 2, items );
+}
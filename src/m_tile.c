@@ -0,0 +1,259 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+
+#include <sulfur/sulfur.h>
+
+#include "m_common.h"
+
+/*
+==============
+Tiling layout
+
+Tiled frames hang off a tree of NODE_GROUP nodes. Every group other than
+the top one holds exactly two children and splits its rectangle between
+them by ratio. Groups have no X window of their own.
+
+Layout is only recomputed for the subtree that changed, and frames whose
+geometry actually moved are queued on configureList. FlushLayout sends
+the queued configures once per event batch.
+==============
+*/
+
+bool tilingEnabled = false;
+
+static node_t* tileRoot = NULL;
+static nodeList_t configureList;
+
+static void ReplaceNodeInList( node_t* old, node_t* new, nodeList_t* list ) {
+	int i;
+
+	for ( i = 0; ( i < list->max ) && ( list->nodes[i] != NULL ); i++ ) {
+		if ( list->nodes[i] == old ) {
+			list->nodes[i] = new;
+			return;
+		}
+	}
+}
+
+static void LayoutNode( node_t* n, short x, short y, short width, short height ) {
+	node_t* a,* b;
+	short share;
+
+	if ( !n )
+		return;
+
+	if ( n->type == NODE_FRAME ) {
+		if ( n->x != x || n->y != y || n->width != width || n->height != height ) {
+			n->x = x;
+			n->y = y;
+			n->width = width;
+			n->height = height;
+			AddNodeToList( n, &configureList );
+		}
+		return;
+	}
+
+	n->x = x;
+	n->y = y;
+	n->width = width;
+	n->height = height;
+
+	a = n->children.nodes[0];
+	b = a ? n->children.nodes[1] : NULL;
+	if ( !b ) {
+		LayoutNode( a, x, y, width, height );
+		return;
+	}
+
+	if ( n->split == SPLIT_HORIZONTAL ) {
+		share = width * n->ratio / 1000;
+		LayoutNode( a, x, y, share, height );
+		LayoutNode( b, x + share, y, width - share, height );
+	} else {
+		share = height * n->ratio / 1000;
+		LayoutNode( a, x, y, width, share );
+		LayoutNode( b, x, y + share, width, height - share );
+	}
+}
+
+static void Relayout( node_t* n ) {
+	LayoutNode( n, n->x, n->y, n->width, n->height );
+}
+
+static node_t* CreateGroup( node_t* parent, splitDir_t split ) {
+	node_t* g = CreateNode( NODE_GROUP, XCB_NONE, parent, 0, 0, 0, 0 );
+
+	if ( !g )
+		return NULL;
+	g->split = split;
+	g->ratio = 500;
+	return g;
+}
+
+// finds a frame to split when there is no focused tiled frame
+static node_t* LastLeaf( node_t* n ) {
+	int i;
+
+	while ( n && n->type == NODE_GROUP ) {
+		for ( i = 0; ( i + 1 < n->children.max ) && ( n->children.nodes[i + 1] != NULL ); i++ )
+			;;
+		n = n->children.nodes[i];
+	}
+	return n;
+}
+
+void TileInsert( node_t* frame ) {
+	node_t* target;
+	node_t* parent;
+	node_t* g;
+
+	if ( !tilingEnabled || !frame || frame->type != NODE_FRAME || IsTiled( frame ) )
+		return;
+
+	if ( !tileRoot ) {
+		tileRoot = CreateGroup( rootNode, SPLIT_HORIZONTAL );
+		if ( !tileRoot )
+			return;
+		tileRoot->width = rootNode->width;
+		tileRoot->height = rootNode->height;
+	}
+
+	RemoveNodeFromList( frame, &frame->parent->children );
+
+	// the first two windows share the top group directly
+	if ( tileRoot->children.nodes[0] == NULL || tileRoot->children.nodes[1] == NULL ) {
+		frame->parent = tileRoot;
+		AddNodeToList( frame, &tileRoot->children );
+		Relayout( tileRoot );
+		return;
+	}
+
+	target = GetParentFrame( windowList.nodes[0] );
+	if ( !IsTiled( target ) || target == frame )
+		target = LastLeaf( tileRoot );
+	parent = target->parent;
+
+	// split the target's cell along its longer side
+	g = CreateGroup( parent, target->width >= target->height ? SPLIT_HORIZONTAL : SPLIT_VERTICAL );
+	if ( !g ) {
+		frame->parent = rootNode;
+		AddNodeToList( frame, &rootNode->children );
+		return;
+	}
+	ReplaceNodeInList( target, g, &parent->children );
+	target->parent = g;
+	frame->parent = g;
+	AddNodeToList( target, &g->children );
+	AddNodeToList( frame, &g->children );
+	LayoutNode( g, target->x, target->y, target->width, target->height );
+}
+
+void TileRemove( node_t* frame ) {
+	node_t* g;
+	node_t* sibling;
+
+	if ( !IsTiled( frame ) )
+		return;
+
+	g = frame->parent;
+	RemoveNodeFromList( frame, &g->children );
+	RemoveNodeFromList( frame, &configureList );
+	frame->parent = rootNode;
+	AddNodeToList( frame, &rootNode->children );
+
+	if ( g == tileRoot ) {
+		Relayout( tileRoot );
+		return;
+	}
+
+	// a split with one side gone collapses into the remaining side
+	sibling = g->children.nodes[0];
+	ReplaceNodeInList( g, sibling, &g->parent->children );
+	sibling->parent = g->parent;
+	LayoutNode( sibling, g->x, g->y, g->width, g->height );
+	AcctFree( ACCT_LISTS, g->children.nodes );
+	AcctFree( ACCT_NODES, g );
+}
+
+// moves the split that owns the frame's right or bottom edge
+static void MoveEdge( node_t* frame, splitDir_t dir, short size ) {
+	node_t* child = frame;
+	node_t* g = frame->parent;
+	int edge, ratio;
+
+	for ( ; g && g->type == NODE_GROUP; child = g, g = g->parent ) {
+		if ( g->split != dir || g->children.nodes[0] != child || g->children.nodes[1] == NULL )
+			continue;
+		if ( dir == SPLIT_HORIZONTAL )
+			edge = frame->x + size - g->x;
+		else
+			edge = frame->y + size - g->y;
+		// clamped before it's stored, a pointer far past the group would wrap a short
+		ratio = edge * 1000 / ( dir == SPLIT_HORIZONTAL ? g->width : g->height );
+		if ( ratio < 50 )
+			ratio = 50;
+		if ( ratio > 950 )
+			ratio = 950;
+		g->ratio = ratio;
+		Relayout( g );
+		return;
+	}
+}
+
+void TileResize( node_t* frame, short width, short height ) {
+	if ( !IsTiled( frame ) )
+		return;
+	width += BORDER_SIZE_LEFT + BORDER_SIZE_RIGHT + 1;
+	height += BORDER_SIZE_TOP + BORDER_SIZE_BOTTOM + 1;
+	if ( width != frame->width )
+		MoveEdge( frame, SPLIT_HORIZONTAL, width );
+	if ( height != frame->height )
+		MoveEdge( frame, SPLIT_VERTICAL, height );
+}
+
+// tiles every mapped frame that isn't tiled yet, e.g. after a restart
+void TileAll( void ) {
+	int i;
+	node_t* n;
+
+	if ( !tilingEnabled )
+		return;
+	for ( i = 0; ( i < rootNode->children.max ) && ( ( n = rootNode->children.nodes[i] ) != NULL ); ) {
+		if ( n->type != NODE_FRAME || !GetActiveTab( n ) || GetActiveTab( n )->windowState != STATE_NORMAL ) {
+			i++;
+			continue;
+		}
+		// tiling takes the frame out of the root's children, so i stays put
+		TileInsert( n );
+		if ( !IsTiled( n ) )
+			return;
+	}
+}
+
+void FlushLayout( void ) {
+	node_t* n;
+
+	while ( configureList.nodes && ( n = configureList.nodes[0] ) != NULL ) {
+		if ( GetActiveTab( n ) ) {
+			ConfigureClient( GetActiveTab( n ), n->x, n->y,
+				n->width - ( BORDER_SIZE_LEFT + BORDER_SIZE_RIGHT + 1 ),
+				n->height - ( BORDER_SIZE_TOP + BORDER_SIZE_BOTTOM + 1 ) );
+			AddNodeToList( n, &redrawList );
+		}
+		RemoveNodeFromList( n, &configureList );
+	}
+}
+
+// frees the top group and pending configures; every frame is gone by now
+void TileShutdown( void ) {
+	if ( tileRoot ) {
+		AcctFree( ACCT_LISTS, tileRoot->children.nodes );
+		AcctFree( ACCT_NODES, tileRoot );
+		tileRoot = NULL;
+	}
+	AcctFree( ACCT_LISTS, configureList.nodes );
+	configureList.nodes = NULL;
+	configureList.max = 0;
+}
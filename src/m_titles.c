@@ -0,0 +1,150 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <time.h>
+
+#include <sulfur/sulfur.h>
+
+#include "m_common.h"
+
+/*
+=============
+Title updates
+
+A title change only marks its client. Once per event batch the newest
+title of every marked client is fetched, all requests going out before
+any reply is read. After an update a client waits titleInterval ms
+before its title is fetched again, however often it changes it in the
+meantime. The main loop sleeps no longer than the earliest wait, so the
+last title a client sets is shown at most that long after it was set.
+=============
+*/
+
+int titleInterval = 100;
+
+typedef struct {
+	xcb_window_t window;
+	xcb_atom_t atom;			// the name to fetch, or none if up to date
+	long long notBefore;		// ms
+	xcb_get_property_cookie_t cookie;
+} titleState_t;
+
+static titleState_t* titles = NULL;
+static int titleCount = 0;
+static int titleMax = 0;
+
+static long notifyCount, fetchCount;
+
+static long long NowMs( void ) {
+	struct timespec ts;
+
+	clock_gettime( CLOCK_MONOTONIC, &ts );
+	return (long long)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+void QueueTitle( node_t* n, xcb_atom_t atom ) {
+	titleState_t* t = NULL;
+	int i;
+
+	notifyCount++;
+	for ( i = 0; i < titleCount; i++ ) {
+		if ( titles[i].window == n->window ) {
+			t = &titles[i];
+			break;
+		}
+	}
+	if ( !t ) {
+		if ( titleCount == titleMax ) {
+			titleMax += 4;
+			titles = AcctRealloc( ACCT_LISTS, titles, sizeof( titleState_t ) * titleMax );
+			if ( !titles ) {
+				fprintf( stderr, "failure growing title list\n" );
+				Quit( 2 );
+			}
+		}
+		t = &titles[titleCount++];
+		memset( t, 0, sizeof( titleState_t ) );
+		t->window = n->window;
+	}
+	// clients that set both are read as UTF-8
+	if ( t->atom != _NET_WM_NAME )
+		t->atom = atom;
+}
+
+// how long the main loop may sleep before a title is due, or -1
+int TitleTimeout( void ) {
+	long long now = NowMs(), wait = -1;
+	int i;
+
+	for ( i = 0; i < titleCount; i++ ) {
+		if ( titles[i].atom == XCB_NONE )
+			continue;
+		if ( titles[i].notBefore <= now )
+			return 0;
+		if ( wait < 0 || titles[i].notBefore - now < wait )
+			wait = titles[i].notBefore - now;
+	}
+	return wait;
+}
+
+static void ApplyTitle( titleState_t* t, xcb_get_property_reply_t* reply ) {
+	node_t* n = GetNodeByWindow( t->window );
+	int len;
+
+	if ( !n || !reply )
+		return;
+	len = xcb_get_property_value_length( reply );
+	if ( len == 0 )
+		return;
+	if ( len > 255 )
+		len = 255;
+	if ( !memcmp( n->name, xcb_get_property_value( reply ), len ) && n->name[len] == '\0' )
+		return;
+	memcpy( n->name, xcb_get_property_value( reply ), len );
+	n->name[len] = '\0';
+	AddNodeToList( n, &redrawList );
+}
+
+// called once per event batch, after the batch's requests have gone out
+void FlushTitles( void ) {
+	long long now = NowMs();
+	xcb_get_property_reply_t* reply;
+	int i;
+
+	for ( i = 0; i < titleCount; i++ ) {
+		if ( titles[i].atom == XCB_NONE || titles[i].notBefore > now )
+			continue;
+		titles[i].cookie = xcb_get_property( c, 0, titles[i].window, titles[i].atom,
+			titles[i].atom == _NET_WM_NAME ? UTF8_STRING : XCB_ATOM_STRING, 0, 64 );
+	}
+
+	for ( i = 0; i < titleCount; ) {
+		if ( titles[i].atom != XCB_NONE && titles[i].notBefore <= now ) {
+			reply = xcb_get_property_reply( c, titles[i].cookie, NULL );
+			ApplyTitle( &titles[i], reply );
+			free( reply );
+			fetchCount++;
+			titles[i].atom = XCB_NONE;
+			titles[i].notBefore = now + titleInterval;
+			i++;
+		} else if ( titles[i].atom == XCB_NONE && titles[i].notBefore <= now ) {
+			// quiet for a whole interval, so the next change is shown at once
+			titles[i] = titles[--titleCount];
+		} else {
+			i++;
+		}
+	}
+}
+
+void TitleReport( FILE* f ) {
+	fprintf( f, "%-10s %10s %10s %10s\n", "titles", "changes", "fetches", "waiting" );
+	fprintf( f, "%-10s %10li %10li %10i\n", "", notifyCount, fetchCount, titleCount );
+}
+
+// no replies are outstanding between batches
+void TitlesShutdown( void ) {
+	AcctFree( ACCT_LISTS, titles );
+	titles = NULL;
+	titleCount = titleMax = 0;
+}
@@ -0,0 +1,132 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <sulfur/sulfur.h>
+
+#include "m_common.h"
+
+/*
+=======
+Tracing
+
+When debug:trace names a file, each event handler and each step after a
+batch is recorded as a span in a fixed ring, the oldest spans giving way
+to new ones. Recording is a clock read and a store into memory allocated
+up front, so tracing doesn't bend the timings it's measuring. The ring is
+written out as Chrome trace JSON on shutdown, on restart and when stats
+are asked for, ready to be opened in Perfetto or chrome://tracing.
+=======
+*/
+
+typedef struct {
+	const char* name;
+	traceTime_t start;
+	traceTime_t duration;
+	xcb_window_t window;
+} traceSpan_t;
+
+bool traceEnabled = false;
+static char* tracePath;
+static traceSpan_t* spans;
+static unsigned int spanMax, spanNext;
+static unsigned long long spanTotal;
+
+static const char* eventNames[] = {
+	"error", "reply", "KeyPress", "KeyRelease", "ButtonPress", "ButtonRelease",
+	"MotionNotify", "EnterNotify", "LeaveNotify", "FocusIn", "FocusOut",
+	"KeymapNotify", "Expose", "GraphicsExposure", "NoExposure", "VisibilityNotify",
+	"CreateNotify", "DestroyNotify", "UnmapNotify", "MapNotify", "MapRequest",
+	"ReparentNotify", "ConfigureNotify", "ConfigureRequest", "GravityNotify",
+	"ResizeRequest", "CirculateNotify", "CirculateRequest", "PropertyNotify",
+	"SelectionClear", "SelectionRequest", "SelectionNotify", "ColormapNotify",
+	"ClientMessage", "MappingNotify", "GenericEvent",
+};
+
+const char* TraceEventName( unsigned char type ) {
+	if ( type < sizeof( eventNames ) / sizeof( eventNames[0] ) )
+		return eventNames[type];
+	return "extension event";
+}
+
+void SetupTrace( const char* path, int count ) {
+	if ( !path || !path[0] || count < 1 )
+		return;
+	spans = AcctCalloc( ACCT_TRACE, count, sizeof( traceSpan_t ) );
+	tracePath = AcctCalloc( ACCT_TRACE, strlen( path ) + 1, 1 );
+	if ( !spans || !tracePath ) {
+		fprintf( stderr, "couldn't allocate %i trace spans\n", count );
+		TraceShutdown();
+		return;
+	}
+	strcpy( tracePath, path );
+	spanMax = count;
+	traceEnabled = true;
+}
+
+traceTime_t TraceNow( void ) {
+	struct timespec ts;
+
+	if ( !traceEnabled )
+		return 0;
+	clock_gettime( CLOCK_MONOTONIC, &ts );
+	return (traceTime_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+// name must outlive the trace, it's stored rather than copied
+void TraceSpan( const char* name, traceTime_t start, xcb_window_t window ) {
+	traceSpan_t* s;
+
+	if ( !traceEnabled )
+		return;
+	s = &spans[spanNext];
+	s->name = name;
+	s->start = start;
+	s->duration = TraceNow() - start;
+	s->window = window;
+	spanNext = ( spanNext + 1 ) % spanMax;
+	spanTotal++;
+}
+
+void TraceWrite( void ) {
+	unsigned int i, first, count;
+	const traceSpan_t* s;
+	FILE* f;
+
+	if ( !traceEnabled )
+		return;
+	f = fopen( tracePath, "w" );
+	if ( !f ) {
+		fprintf( stderr, "couldn't write trace to %s\n", tracePath );
+		return;
+	}
+	count = spanTotal < spanMax ? spanTotal : spanMax;
+	first = spanTotal < spanMax ? 0 : spanNext;
+
+	// complete events, microseconds from the monotonic clock
+	fprintf( f, "{\"traceEvents\":[\n" );
+	for ( i = 0; i < count; i++ ) {
+		s = &spans[( first + i ) % spanMax];
+		fprintf( f, "{\"name\":\"%s\",\"ph\":\"X\",\"pid\":%i,\"tid\":1,\"ts\":%.3f,\"dur\":%.3f",
+			s->name, (int)getpid(), s->start / 1000.0, s->duration / 1000.0 );
+		if ( s->window )
+			fprintf( f, ",\"args\":{\"window\":\"0x%x\"}", s->window );
+		fprintf( f, "}%s\n", i + 1 < count ? "," : "" );
+	}
+	fprintf( f, "],\"displayTimeUnit\":\"ms\",\"otherData\":{\"recorded\":%llu,\"kept\":%u}}\n", spanTotal, count );
+	fclose( f );
+	dbgprintf( 1, "wrote %u of %llu trace spans to %s\n", count, spanTotal, tracePath );
+}
+
+void TraceShutdown( void ) {
+	TraceWrite();
+	AcctFree( ACCT_TRACE, spans );
+	AcctFree( ACCT_TRACE, tracePath );
+	spans = NULL;
+	tracePath = NULL;
+	spanMax = spanNext = 0;
+	traceEnabled = false;
+}
@@ -0,0 +1,449 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+
+#include "m_tree.h"
+
+static void NullReparent( node_t* n, node_t* parent, short x, short y ) {}
+static void NullNode( node_t* n ) {}
+static void NullRestack( node_t* n, node_t* sibling ) {}
+static void NullAbort( void ) { abort(); }
+
+// used until something with a display installs a real backend
+static treeBackend_t nullBackend = {
+	NullReparent,
+	NullNode,
+	NullRestack,
+	NullNode,
+	NullNode,
+	NullNode,
+	NullAbort,
+};
+
+treeBackend_t* treeBackend = &nullBackend;
+
+node_t *rootNode = NULL;
+
+nodeList_t windowList; // list of all windows, in most recently raised order
+nodeList_t redrawList; // list of all windows needing redrawn
+
+long raiseCount = 0;
+long raiseSkipCount = 0;
+long restackCount = 0;
+long reapCount = 0;
+long reapedCount = 0;
+
+// nodes waiting for ReapNodes, in the order they were doomed
+static node_t** doomed = NULL;
+static int doomedCount = 0;
+static int doomedMax = 0;
+
+int debugLevel = 99;
+
+void dbgprintf( int level, char* fmt, ... ) {
+	va_list args;
+	va_start( args, fmt );
+	if ( level <= debugLevel ) {
+		vprintf( fmt, args );
+	}
+	va_end( args );
+}
+
+void AddNodeToList( node_t* n, nodeList_t* list ) {
+	int i;
+
+	for ( i = 0 ; i < list->max; i++ ) {
+		if ( list->nodes[i] == NULL || list->nodes[i] == n ) {
+			list->nodes[i] = n;
+			return;
+		}
+	}
+	dbgprintf( 2, "growing client list (current max is %i\n)\n", list->max );
+	list->nodes = AcctRealloc( ACCT_LISTS, list->nodes, sizeof ( node_t* ) * ( list->max += 4 ) );
+	if ( list->nodes == NULL ) {
+		fprintf( stderr, "failure growing window list\n" );
+		treeBackend->outOfMemory();
+		return;
+	}
+	for ( i = list->max - 4; i < list->max; i++ ) {
+		list->nodes[i] = NULL;
+	}
+	dbgprintf( 2, "window list size is %i\n", list->max );
+	AddNodeToList( n, list );
+}
+
+void RemoveNodeFromList( node_t* n, nodeList_t* list ) {
+	int i;
+
+	if ( !list || !n )
+		return;
+
+	for ( i = 0 ; i < list->max; i++ ) {
+		if ( list->nodes[i] == n ) {
+			break;
+		}
+	}
+	if ( i >= list->max ) {
+		dbgprintf( 1, "node not found\n" );
+		return;
+	}
+	for ( i++ ; i < list->max; i++ ) {
+		list->nodes[i - 1] = list->nodes[i];
+		if ( list->nodes[i] == NULL ) {
+			break;
+		}
+	}
+	if ( i >= list->max )
+		list->nodes[list->max - 1] = NULL;
+	if ( i < list->max - 4 ) {
+		dbgprintf( 2, "shrinking client list\n" );
+		list->nodes = AcctRealloc( ACCT_LISTS, list->nodes, sizeof( node_t* ) * ( list->max -= 4 ) );
+		if ( list->nodes == NULL ) {
+			fprintf( stderr, "failure shrinking client list\n" );
+			treeBackend->outOfMemory();
+			return;
+		}
+		dbgprintf( 2, "client list size is %i\n", list->max );
+	}
+}
+
+void MoveNodeToFront( node_t* n, nodeList_t* list ) {
+	int i;
+
+	for ( i = 0; ( i < list->max ) && ( list->nodes[i] != NULL ) && ( list->nodes[i] != n ); i++ ) ;;
+	if ( i >= list->max || list->nodes[i] == NULL )
+		return;
+	for ( ; i >= 1 ; i-- )
+		list->nodes[i] = list->nodes[i - 1];
+	list->nodes[0] = n;
+}
+
+node_t* GetParentFrame( node_t* n ) {
+	node_t* p;
+	for ( p = n; ( p != NULL ) && ( p->type != NODE_FRAME ); p = p->parent )
+		;;
+	return p;
+}
+
+node_t* GetActiveTab( node_t* frame ) {
+	if ( !frame )
+		return NULL;
+	if ( frame->activeTab )
+		return frame->activeTab;
+	return frame->children.nodes[0];
+}
+
+node_t* CreateNode( nodeType_t type, uint32_t wnd, node_t* parent, short width, short height, short x, short y ) {
+	node_t* n = AcctCalloc( ACCT_NODES, 1, sizeof( node_t ) );
+	if ( !n )
+		return NULL;
+	n->children.max = 4;
+	n->children.nodes = AcctCalloc( ACCT_LISTS, n->children.max, sizeof( node_t*) );
+	if ( !n->children.nodes ) {
+		AcctFree( ACCT_NODES, n );
+		return NULL;
+	}
+
+	strncpy( n->name, "untitled", 256 );
+	n->managementState = STATE_INIT;
+	n->windowState = STATE_WITHDRAWN;
+	n->type = type;
+	n->window = wnd;
+	n->parent = parent;
+	n->width = width;
+	n->height = height;
+	n->x = x;
+	n->y = y;
+	return n;
+}
+
+void DestroyNode( node_t* n ) {
+	node_t* child;
+
+	// a doomed node is already on its way out, see ReapNodes
+	if ( !n || n->type == NODE_ROOT || ( n->reap & REAP_DOOMED ) )
+		return;
+
+	treeBackend->detachNode( n );
+
+	// dialogs outlive the window they belonged to, as ordinary windows
+	SetTransientFor( n, NULL );
+	while ( n->transients.nodes && ( child = n->transients.nodes[0] ) != NULL )
+		SetTransientFor( child, NULL );
+
+	// reparent any child windows
+	if ( n->children.nodes && n->parent && n->parent->children.nodes ) {
+		while ( ( child = n->children.nodes[0] ) != NULL ) {
+			treeBackend->reparentWindow( child, n->parent, n->x, n->y );
+			child->parent = n->parent;
+			AddNodeToList( child, &n->parent->children );
+			RemoveNodeFromList( child, &n->children );
+		}
+	}
+
+	RemoveNodeFromList( n, &windowList );
+	RemoveNodeFromList( n, &redrawList );
+	RemoveNodeFromList( n, &n->parent->children );
+	treeBackend->destroyWindow( n );
+	if ( n->parent->type == NODE_FRAME && n->parent->activeTab == n )
+		treeBackend->activeTabClosed( n->parent );
+
+	// if our parent is a frame or group, and it is empty, it should also be destroyed
+	if ( ( n->parent->type == NODE_FRAME ) || ( n->parent->type == NODE_GROUP ) ) {
+		if ( ( n->parent->children.nodes ) && ( n->parent->children.nodes[0] == NULL ) ) {
+			DestroyNode( n->parent );
+		}
+	}
+	AcctFree( ACCT_LISTS, n->children.nodes );
+	AcctFree( ACCT_LISTS, n->transients.nodes );
+	AcctFree( ACCT_NODES, n );
+}
+
+node_t* GetNodeByWindow( uint32_t w ) {
+	int i;
+	for ( i = 0 ; i < windowList.max; i++ ) {
+		if ( windowList.nodes[i] == NULL )
+			return NULL;
+		if ( windowList.nodes[i]->window == w && !( windowList.nodes[i]->reap & REAP_DOOMED ) )
+			return windowList.nodes[i];
+	}
+	return NULL;
+}
+
+/*
+When a client exits it often takes hundreds of windows with it, and the
+DestroyNotify events all arrive in one batch. Taking each out of the tree
+on its own walks windowList and redrawList every time. Instead a destroyed
+window's node is only doomed when its event comes in, which hides it from
+GetNodeByWindow, and ReapNodes takes every doomed node out at the end of
+the batch: each list holding any of them is compacted in a single pass,
+frames left empty are doomed and destroyed along with them, and then the
+nodes are freed. Windows the server destroyed itself get no request.
+*/
+
+static void Doom( node_t* n, unsigned char flags ) {
+	if ( !n || n->type == NODE_ROOT || ( n->reap & REAP_DOOMED ) )
+		return;
+	if ( doomedCount == doomedMax ) {
+		doomedMax += 4;
+		doomed = AcctRealloc( ACCT_LISTS, doomed, sizeof( node_t* ) * doomedMax );
+		if ( !doomed ) {
+			fprintf( stderr, "failure growing doomed list\n" );
+			treeBackend->outOfMemory();
+			return;
+		}
+	}
+	n->reap |= REAP_DOOMED | flags;
+	doomed[doomedCount++] = n;
+}
+
+// n's window no longer exists on the server
+void QueueDestroy( node_t* n ) {
+	Doom( n, REAP_GONE );
+}
+
+// drops doomed nodes from a list, keeping the order of the rest
+static void CompactList( nodeList_t* list ) {
+	int i, kept = 0, max;
+
+	if ( !list->nodes )
+		return;
+	for ( i = 0; ( i < list->max ) && ( list->nodes[i] != NULL ); i++ ) {
+		if ( !( list->nodes[i]->reap & REAP_DOOMED ) )
+			list->nodes[kept++] = list->nodes[i];
+	}
+	max = ( kept / 4 + 1 ) * 4;
+	for ( i = kept; i < list->max; i++ )
+		list->nodes[i] = NULL;
+	if ( max < list->max ) {
+		list->nodes = AcctRealloc( ACCT_LISTS, list->nodes, sizeof( node_t* ) * ( list->max = max ) );
+		if ( list->nodes == NULL ) {
+			fprintf( stderr, "failure shrinking client list\n" );
+			treeBackend->outOfMemory();
+		}
+	}
+}
+
+static bool HasLiveChild( node_t* n ) {
+	int i;
+
+	for ( i = 0; ( i < n->children.max ) && ( n->children.nodes[i] != NULL ); i++ ) {
+		if ( !( n->children.nodes[i]->reap & REAP_DOOMED ) )
+			return true;
+	}
+	return false;
+}
+
+void ReapNodes( void ) {
+	node_t** stale = NULL; // parents whose children lists need compacting
+	int staleCount = 0, staleMax = 0;
+	node_t* n,* p,* child;
+	int i, j;
+
+	if ( doomedCount == 0 )
+		return;
+	reapCount++;
+
+	// emptied frames are doomed as this goes, so the count can grow under it
+	for ( i = 0; i < doomedCount; i++ ) {
+		n = doomed[i];
+		treeBackend->detachNode( n );
+		SetTransientFor( n, NULL );
+		while ( n->transients.nodes && ( child = n->transients.nodes[0] ) != NULL )
+			SetTransientFor( child, NULL );
+		// only empty frames are doomed with their window still there, so any
+		// children belong to a window the server destroyed, and went with it
+		for ( j = 0; ( j < n->children.max ) && ( n->children.nodes[j] != NULL ); j++ )
+			Doom( n->children.nodes[j], REAP_GONE );
+
+		p = n->parent;
+		if ( !p || ( p->reap & REAP_DOOMED ) )
+			continue;
+		if ( !( p->reap & REAP_CHILDREN ) ) {
+			if ( staleCount == staleMax ) {
+				staleMax += 4;
+				stale = AcctRealloc( ACCT_LISTS, stale, sizeof( node_t* ) * staleMax );
+				if ( !stale ) {
+					fprintf( stderr, "failure growing stale list\n" );
+					treeBackend->outOfMemory();
+					return;
+				}
+			}
+			p->reap |= REAP_CHILDREN;
+			stale[staleCount++] = p;
+		}
+		// if our parent is a frame or group, and it is empty, it should also be destroyed
+		if ( ( p->type == NODE_FRAME || p->type == NODE_GROUP ) && !HasLiveChild( p ) )
+			Doom( p, 0 );
+	}
+
+	CompactList( &windowList );
+	CompactList( &redrawList );
+	for ( i = 0; i < staleCount; i++ ) {
+		p = stale[i];
+		p->reap &= ~REAP_CHILDREN;
+		if ( p->reap & REAP_DOOMED )
+			continue;
+		CompactList( &p->children );
+		// with the list compacted, the next tab is a live one
+		if ( p->type == NODE_FRAME && p->activeTab && ( p->activeTab->reap & REAP_DOOMED ) )
+			treeBackend->activeTabClosed( p );
+	}
+	AcctFree( ACCT_LISTS, stale );
+
+	for ( i = 0; i < doomedCount; i++ ) {
+		n = doomed[i];
+		treeBackend->destroyWindow( n );
+		AcctFree( ACCT_LISTS, n->children.nodes );
+		AcctFree( ACCT_LISTS, n->transients.nodes );
+		AcctFree( ACCT_NODES, n );
+	}
+	reapedCount += doomedCount;
+	dbgprintf( 2, "reaped %i nodes\n", doomedCount );
+	// storms are rare, so the list isn't kept around between them
+	AcctFree( ACCT_LISTS, doomed );
+	doomed = NULL;
+	doomedCount = doomedMax = 0;
+}
+
+void SetTransientFor( node_t* n, node_t* parent ) {
+	node_t* p;
+
+	if ( n->transientFor == parent )
+		return;
+	// a loop would make the group unbounded
+	for ( p = parent; p != NULL; p = p->transientFor ) {
+		if ( p == n )
+			return;
+	}
+	if ( n->transientFor )
+		RemoveNodeFromList( n, &n->transientFor->transients );
+	n->transientFor = parent;
+	if ( parent )
+		AddNodeToList( n, &parent->transients );
+}
+
+/*
+A transient group is a window and every dialog transient for it, directly
+or not. Raising any member raises the whole group, with each dialog kept
+above the window it belongs to. Top down, the group is ordered by a walk
+that visits a window's transients (most recently raised first) before the
+window itself; withdrawn members are left where they are.
+*/
+
+static bool InGroupOrder( node_t* n, node_t* raised ) {
+	if ( n->reap & REAP_DOOMED )
+		return false;
+	return n == raised || n->windowState == STATE_NORMAL;
+}
+
+// checks whether the group already heads windowList in the right order
+static bool GroupOnTop( node_t* n, node_t* raised, int* pos ) {
+	int i;
+
+	for ( i = 0; ( i < n->transients.max ) && ( n->transients.nodes[i] != NULL ); i++ ) {
+		if ( !GroupOnTop( n->transients.nodes[i], raised, pos ) )
+			return false;
+	}
+	if ( !InGroupOrder( n, raised ) )
+		return true;
+	if ( *pos >= windowList.max || windowList.nodes[*pos] != n )
+		return false;
+	( *pos )++;
+	return true;
+}
+
+// moves the group to the front of windowList and restacks it bottom up, each
+// window relative to the one below it
+static void StackGroup( node_t* n, node_t* raised, node_t** below ) {
+	node_t* top;
+	int i;
+
+	if ( InGroupOrder( n, raised ) ) {
+		MoveNodeToFront( n, &windowList );
+		top = GetParentFrame( n );
+		if ( !top )
+			top = n;
+		// tabs of one frame only need it restacked once
+		if ( top != *below && top->type != NODE_ROOT ) {
+			treeBackend->restackWindow( top, *below );
+			restackCount++;
+			*below = top;
+		}
+	}
+	for ( i = 0; ( i < n->transients.max ) && ( n->transients.nodes[i] != NULL ); i++ )
+		;;
+	while ( --i >= 0 )
+		StackGroup( n->transients.nodes[i], raised, below );
+}
+
+void RaiseClient( node_t *n ) {
+	node_t* p = GetParentFrame( n );
+	node_t* old = GetParentFrame( windowList.nodes[0] );
+	node_t* leader,* t,* below = NULL;
+	int pos = 0;
+
+	if ( n == p )
+		n = GetActiveTab( p );
+
+	if ( !n )
+		return;
+	raiseCount++;
+
+	// the raised window goes first among its siblings, all the way up
+	for ( t = n; t->transientFor != NULL; t = t->transientFor )
+		MoveNodeToFront( t, &t->transientFor->transients );
+	leader = t;
+
+	if ( GroupOnTop( leader, n, &pos ) ) {
+		raiseSkipCount++;
+		return;
+	}
+	StackGroup( leader, n, &below );
+
+	treeBackend->focusWindow( windowList.nodes[0] );
+
+	AddNodeToList( GetParentFrame( windowList.nodes[0] ), &redrawList );
+	AddNodeToList( old, &redrawList );
+}
@@ -0,0 +1,176 @@
+/*
+=========
+Node tree
+
+The node tree and stacking order, with no dependency on X. Anything that
+has to reach the server goes through treeBackend, so the tree can be
+driven without a display.
+=========
+*/
+
+#ifndef M_TREE_H
+#define M_TREE_H
+
+#include <stdio.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+typedef enum {
+	STATE_WITHDRAWN = 0,
+	STATE_ICON = 1,
+	STATE_NORMAL = 3,
+} clientWindowState_t;
+
+typedef enum {
+	STATE_INIT,
+	STATE_NO_REDIRECT, //override redirect
+	STATE_REPARENTED,
+	STATE_CHILD,
+	STATE_TRANSIENT,
+	STATE_UNFRAMED, // managed on the root, the client draws its own decorations
+	STATE_TRACKED, // top-level but not mapped, so it has no frame yet
+} clientManagementState_t;
+
+// node_t.fullscreen
+#define FULLSCREEN_ON ( 1 << 0 )
+#define FULLSCREEN_FRAMED ( 1 << 1 ) // it goes into a frame when it leaves
+
+// node_t.reap
+#define REAP_DOOMED ( 1 << 0 ) // waiting to be freed by ReapNodes, invisible to lookups
+#define REAP_GONE ( 1 << 1 ) // the server destroyed the window itself, so nothing is sent for it
+#define REAP_CHILDREN ( 1 << 2 ) // children holds doomed nodes, ReapNodes compacts it
+
+typedef enum {
+	NODE_ROOT,
+	NODE_CLIENT,
+	NODE_FRAME,
+	NODE_GROUP,
+} nodeType_t;
+
+typedef enum {
+	SPLIT_HORIZONTAL, // children side by side
+	SPLIT_VERTICAL, // children stacked
+} splitDir_t;
+
+// what WM_NORMAL_HINTS allows a client's size to be, zero where it says nothing.
+// sizes are clamped to what an X window can be when read.
+typedef struct {
+	int minWidth, minHeight;
+	int maxWidth, maxHeight;
+	int baseWidth, baseHeight;
+	int incWidth, incHeight;
+	int minAspectX, minAspectY; // width over height, as a fraction
+	int maxAspectX, maxAspectY;
+} sizeHints_t;
+
+struct node_s;
+
+typedef struct nodeList_s {
+	struct node_s** nodes;
+	int max;
+} nodeList_t;
+
+typedef struct node_s {
+	nodeType_t type;
+	uint32_t window; // an xcb_window_t, kept plain so the tree needs no X headers
+	char name[256];
+	short x, y, width, height;
+
+	struct node_s* parent;
+	struct nodeList_s children;
+	char parentMapped;
+	
+	clientWindowState_t windowState;
+	clientManagementState_t managementState;
+
+	struct node_s* activeTab; // frames only, the client currently shown
+	uint32_t picture; // frames only, render picture for title text once drawn
+	struct node_s* transientFor; // clients only, from WM_TRANSIENT_FOR
+	struct nodeList_s transients; // clients only, in most recently raised order
+	unsigned char ignoreUnmap; // unmaps we caused ourselves and should not act on
+	unsigned char fullscreen; // clients only, FULLSCREEN_* flags
+	unsigned char placed; // clients only, has been shown once, so placement rules are done with it
+	short restoreX, restoreY, restoreWidth, restoreHeight; // clients only, geometry to leave fullscreen with
+	sizeHints_t sizeHints; // clients only
+	short configuredWidth, configuredHeight; // clients only, the size last sent to the server, 0 if unknown
+	unsigned char reap; // REAP_* flags
+	uint32_t pid; // clients only, from _NET_WM_PID if the client runs on this machine, else 0
+
+	splitDir_t split; // groups only
+	short ratio; // groups only, share of the first child in thousandths
+	//todo: gravity
+} node_t;
+
+typedef struct {
+	void (*reparentWindow)( node_t* n, node_t* parent, short x, short y );
+	void (*destroyWindow)( node_t* n );
+	void (*restackWindow)( node_t* n, node_t* sibling ); // put top-level n just above sibling, or on top
+	void (*focusWindow)( node_t* n );
+	void (*detachNode)( node_t* n ); // n is about to leave the tree
+	void (*activeTabClosed)( node_t* frame );
+	void (*outOfMemory)( void );
+} treeBackend_t;
+
+/* m_account.c */
+typedef enum {
+	ACCT_NODES,
+	ACCT_LISTS,
+	ACCT_RESTART,
+	ACCT_MESSAGES,
+	ACCT_STARTUP,
+	ACCT_TEXT,
+	ACCT_TRACE,
+	ACCT_RULES,
+	ACCT_IMAGES,
+	ACCT_MEM_COUNT
+} acctMem_t;
+
+typedef enum {
+	ACCT_X_WINDOW,
+	ACCT_X_GC,
+	ACCT_X_PIXMAP,
+	ACCT_X_FONT,
+	ACCT_X_CURSOR,
+	ACCT_X_PICTURE,
+	ACCT_X_GLYPHSET,
+	ACCT_X_COUNT
+} acctXRes_t;
+
+extern bool accountingEnabled;
+
+void* AcctCalloc( acctMem_t kind, size_t count, size_t size );
+void* AcctRealloc( acctMem_t kind, void* ptr, size_t size );
+void AcctFree( acctMem_t kind, void* ptr );
+void AcctXCreate( acctXRes_t kind );
+void AcctXFree( acctXRes_t kind );
+void AcctReport( FILE* f );
+long AcctLeakReport( const char* path );
+
+/* m_tree.c */
+extern int debugLevel;
+extern treeBackend_t* treeBackend;
+extern node_t *rootNode;
+extern nodeList_t windowList;
+extern nodeList_t redrawList;
+extern long raiseCount; // calls to RaiseClient
+extern long raiseSkipCount; // raises that found the window already on top
+extern long restackCount; // restack requests sent by raises
+extern long reapCount; // calls to ReapNodes that found work
+extern long reapedCount; // nodes freed by them
+
+void dbgprintf( int level, char* fmt, ... );
+void AddNodeToList( node_t* n, nodeList_t* list );
+void RemoveNodeFromList( node_t* n, nodeList_t* list );
+void MoveNodeToFront( node_t* n, nodeList_t* list );
+node_t* GetParentFrame( node_t* n );
+node_t* GetActiveTab( node_t* frame );
+node_t* CreateNode( nodeType_t type, uint32_t wnd, node_t* parent, short width, short height, short x, short y );
+void DestroyNode( node_t* n );
+void QueueDestroy( node_t* n );
+void ReapNodes( void );
+node_t* GetNodeByWindow( uint32_t w );
+void SetTransientFor( node_t* n, node_t* parent );
+void RaiseClient( node_t *n );
+
+#endif
@@ -0,0 +1,328 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <sulfur/sulfur.h>
+
+#include "m_common.h"
+
+/*
+==============
+Resource usage
+
+With usage:overlay set, each client's title bar also shows the CPU and
+resident memory of the process behind it, so a client dragging the
+desktop down can be picked out. The process comes from _NET_WM_PID, read
+with the other map-time hints, and only counts when WM_CLIENT_MACHINE
+names this host. Its /proc stat and statm files are opened once, kept
+open, and read again every usage:interval ms; a process with several
+windows is still read once. Only a client whose figures change as shown
+is queued for a redraw.
+==============
+*/
+
+bool usageEnabled = false;
+static int usageInterval = 2000;
+
+typedef struct {
+	uint32_t pid; // 0 for a free slot
+	int statFd, statmFd; // -1 once the process has gone
+	int users; // watched windows it owns
+	unsigned long long ticks; // utime and stime at the last sample
+	long long sampledAt; // ms
+	bool changed; // text differs from the last interval
+	char text[24]; // what the title bar shows, empty until there's a rate
+} process_t;
+
+typedef struct {
+	xcb_window_t window;
+	int process;
+} watch_t;
+
+static process_t* processes = NULL;
+static int processMax = 0;
+static watch_t* watches = NULL;
+static int watchCount = 0;
+static int watchMax = 0;
+
+static long long nextSample;
+static long clockTicks, pageSize;
+static char hostname[256];
+
+static long sampleCount, readCount, redrawCount;
+
+static long long NowMs( void ) {
+	struct timespec ts;
+
+	clock_gettime( CLOCK_MONOTONIC, &ts );
+	return (long long)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+void SetupUsage( bool enabled, int interval ) {
+	usageEnabled = enabled;
+	if ( interval > 0 )
+		usageInterval = interval;
+	clockTicks = sysconf( _SC_CLK_TCK );
+	pageSize = sysconf( _SC_PAGESIZE );
+	if ( gethostname( hostname, sizeof( hostname ) - 1 ) < 0 )
+		hostname[0] = '\0';
+	if ( clockTicks <= 0 || pageSize <= 0 )
+		usageEnabled = false;
+}
+
+// a pid means nothing here unless the client runs on this machine
+uint32_t UsagePid( xcb_get_property_reply_t* pid, xcb_get_property_reply_t* machine ) {
+	int len;
+
+	if ( !pid || pid->format != 32 || xcb_get_property_value_length( pid ) < 4 )
+		return 0;
+	if ( !machine || machine->format != 8 )
+		return 0;
+	len = xcb_get_property_value_length( machine );
+	if ( len != (int)strlen( hostname ) || memcmp( xcb_get_property_value( machine ), hostname, len ) )
+		return 0;
+	return *(uint32_t*)xcb_get_property_value( pid );
+}
+
+static void FormatText( process_t* p, int cpu, long residentKb ) {
+	char text[sizeof( p->text )];
+
+	if ( residentKb >= 1024 * 1024 )
+		snprintf( text, sizeof( text ), "%i%% %.1fG", cpu, residentKb / ( 1024.0 * 1024.0 ) );
+	else
+		snprintf( text, sizeof( text ), "%i%% %liM", cpu, residentKb / 1024 );
+	if ( strcmp( text, p->text ) ) {
+		strcpy( p->text, text );
+		p->changed = true;
+	}
+}
+
+static void CloseProcess( process_t* p ) {
+	if ( p->statFd >= 0 )
+		close( p->statFd );
+	if ( p->statmFd >= 0 )
+		close( p->statmFd );
+	p->statFd = p->statmFd = -1;
+	if ( p->text[0] ) {
+		p->text[0] = '\0';
+		p->changed = true;
+	}
+}
+
+// one read of each file, from the start, through the descriptors kept open
+static void Sample( process_t* p, long long now ) {
+	unsigned long long utime, stime, ticks;
+	long resident;
+	char buf[512];
+	char* s;
+	ssize_t len;
+
+	if ( p->statFd < 0 )
+		return;
+	readCount += 2;
+	len = pread( p->statFd, buf, sizeof( buf ) - 1, 0 );
+	if ( len <= 0 ) {
+		CloseProcess( p );
+		return;
+	}
+	buf[len] = '\0';
+	// the command name may hold spaces or parentheses, so fields count from the last ')'
+	s = strrchr( buf, ')' );
+	if ( !s || sscanf( s + 1, " %*c %*d %*d %*d %*d %*d %*u %*u %*u %*u %*u %llu %llu", &utime, &stime ) != 2 ) {
+		CloseProcess( p );
+		return;
+	}
+	len = pread( p->statmFd, buf, sizeof( buf ) - 1, 0 );
+	if ( len <= 0 ) {
+		CloseProcess( p );
+		return;
+	}
+	buf[len] = '\0';
+	if ( sscanf( buf, "%*u %li", &resident ) != 1 )
+		resident = 0;
+
+	ticks = utime + stime;
+	// the first sample has nothing to measure a rate against
+	if ( p->sampledAt && now > p->sampledAt )
+		FormatText( p, (int)( ( ticks - p->ticks ) * 100000 / ( clockTicks * ( now - p->sampledAt ) ) ), resident * ( pageSize / 1024 ) );
+	p->ticks = ticks;
+	p->sampledAt = now;
+}
+
+static int OpenProcess( uint32_t pid ) {
+	char path[64];
+	process_t* p;
+	int i, slot = -1;
+
+	for ( i = 0; i < processMax; i++ ) {
+		if ( processes[i].pid == pid )
+			return i;
+		if ( processes[i].pid == 0 && slot < 0 )
+			slot = i;
+	}
+	if ( slot < 0 ) {
+		slot = processMax;
+		processMax += 4;
+		processes = AcctRealloc( ACCT_LISTS, processes, sizeof( process_t ) * processMax );
+		if ( !processes ) {
+			fprintf( stderr, "failure growing process list\n" );
+			Quit( 2 );
+		}
+		for ( i = slot; i < processMax; i++ )
+			processes[i].pid = 0;
+	}
+
+	p = &processes[slot];
+	memset( p, 0, sizeof( process_t ) );
+	snprintf( path, sizeof( path ), "/proc/%u/stat", pid );
+	p->statFd = open( path, O_RDONLY | O_CLOEXEC );
+	snprintf( path, sizeof( path ), "/proc/%u/statm", pid );
+	p->statmFd = open( path, O_RDONLY | O_CLOEXEC );
+	if ( p->statFd < 0 || p->statmFd < 0 ) {
+		CloseProcess( p );
+		return -1;
+	}
+	p->pid = pid;
+	Sample( p, NowMs() );
+	return slot;
+}
+
+static void DropWatch( int i ) {
+	process_t* p = &processes[watches[i].process];
+
+	if ( --p->users == 0 ) {
+		CloseProcess( p );
+		p->pid = 0;
+	}
+	watches[i] = watches[--watchCount];
+}
+
+static int FindWatch( xcb_window_t window ) {
+	int i;
+
+	for ( i = 0; i < watchCount; i++ ) {
+		if ( watches[i].window == window )
+			return i;
+	}
+	return -1;
+}
+
+void UsageWatch( node_t* n ) {
+	int i, process;
+
+	if ( !usageEnabled || n->type != NODE_CLIENT || n->pid == 0 )
+		return;
+	i = FindWatch( n->window );
+	if ( i >= 0 ) {
+		if ( processes[watches[i].process].pid == n->pid )
+			return;
+		DropWatch( i );
+	}
+	process = OpenProcess( n->pid );
+	if ( process < 0 )
+		return;
+
+	if ( watchCount == watchMax ) {
+		watchMax += 4;
+		watches = AcctRealloc( ACCT_LISTS, watches, sizeof( watch_t ) * watchMax );
+		if ( !watches ) {
+			fprintf( stderr, "failure growing usage list\n" );
+			Quit( 2 );
+		}
+	}
+	if ( watchCount == 0 )
+		nextSample = NowMs() + usageInterval;
+	watches[watchCount].window = n->window;
+	watches[watchCount].process = process;
+	watchCount++;
+	processes[process].users++;
+}
+
+void UsageForget( node_t* n ) {
+	int i;
+
+	if ( watchCount == 0 || ( i = FindWatch( n->window ) ) < 0 )
+		return;
+	DropWatch( i );
+}
+
+// how long the main loop may sleep before the next sample is due, or -1
+int UsageTimeout( void ) {
+	long long wait;
+
+	if ( watchCount == 0 )
+		return -1;
+	wait = nextSample - NowMs();
+	return wait > 0 ? (int)wait : 0;
+}
+
+// called once per event batch, samples only once an interval has passed
+void FlushUsage( void ) {
+	long long now;
+	node_t* n;
+	int i;
+
+	if ( watchCount == 0 || ( now = NowMs() ) < nextSample )
+		return;
+	nextSample = now + usageInterval;
+	sampleCount++;
+
+	for ( i = 0; i < processMax; i++ ) {
+		if ( processes[i].pid )
+			Sample( &processes[i], now );
+	}
+	for ( i = 0; i < watchCount; i++ ) {
+		if ( !processes[watches[i].process].changed )
+			continue;
+		n = GetNodeByWindow( watches[i].window );
+		if ( n && GetParentFrame( n ) ) {
+			AddNodeToList( n, &redrawList );
+			redrawCount++;
+		}
+	}
+	for ( i = 0; i < processMax; i++ )
+		processes[i].changed = false;
+}
+
+// the text for n's title bar, which is just its name when there's nothing to add
+const char* UsageLabel( node_t* n, char* buf, int size ) {
+	const char* text;
+	int i;
+
+	if ( watchCount == 0 || ( i = FindWatch( n->window ) ) < 0 )
+		return n->name;
+	text = processes[watches[i].process].text;
+	if ( !text[0] )
+		return n->name;
+	snprintf( buf, size, "%s  %s", n->name, text );
+	return buf;
+}
+
+void UsageReport( FILE* f ) {
+	int i, open = 0;
+
+	for ( i = 0; i < processMax; i++ ) {
+		if ( processes[i].pid && processes[i].statFd >= 0 )
+			open++;
+	}
+	fprintf( f, "%-10s %10s %10s %10s %10s %10s\n", "usage", "windows", "processes", "samples", "reads", "redraws" );
+	fprintf( f, "%-10s %10i %10i %10li %10li %10li\n", "", watchCount, open, sampleCount, readCount, redrawCount );
+}
+
+void UsageShutdown( void ) {
+	int i;
+
+	for ( i = 0; i < processMax; i++ ) {
+		if ( processes[i].pid )
+			CloseProcess( &processes[i] );
+	}
+	AcctFree( ACCT_LISTS, processes );
+	AcctFree( ACCT_LISTS, watches );
+	processes = NULL;
+	watches = NULL;
+	processMax = watchCount = watchMax = 0;
+}
@@ -0,0 +1,295 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/ipc.h>
+#include <sys/shm.h>
+
+#include <png.h>
+#include <sulfur/sulfur.h>
+#include <xcb/shm.h>
+
+#include "m_common.h"
+
+/*
+=========
+Wallpaper
+
+wallpaper:file names a PNG or binary PPM (P6, maxval 255) image, and
+wallpaper:mode is stretch, the default, or fill, which crops the image to
+the screen's shape instead of distorting it. The image is decoded, scaled
+to the screen straight into a shared memory segment, converted to the
+root visual in place and uploaded once into a pixmap that becomes the
+root's background. From then on the server repaints the root by itself,
+so exposing it costs makron nothing. The pixmap is also published as
+_XROOTPMAP_ID for clients that draw pseudo transparency, and is kept
+until shutdown.
+=========
+*/
+
+#define WALLPAPER_MAX_SIZE 16384
+
+static xcb_pixmap_t wallpaper;
+
+static double MsBetween( const struct timespec* a, const struct timespec* b ) {
+	return ( b->tv_sec - a->tv_sec ) * 1000.0 + ( b->tv_nsec - a->tv_nsec ) / 1000000.0;
+}
+
+static unsigned char* LoadPng( const char* path, int* width, int* height ) {
+	png_image image;
+	unsigned char* pixels;
+
+	memset( &image, 0, sizeof( image ) );
+	image.version = PNG_IMAGE_VERSION;
+	if ( !png_image_begin_read_from_file( &image, path ) ) {
+		fprintf( stderr, "couldn't read %s: %s\n", path, image.message );
+		return NULL;
+	}
+	image.format = PNG_FORMAT_RGBA;
+	if ( image.width > WALLPAPER_MAX_SIZE || image.height > WALLPAPER_MAX_SIZE ) {
+		fprintf( stderr, "%s is too big for a wallpaper\n", path );
+		png_image_free( &image );
+		return NULL;
+	}
+	pixels = AcctCalloc( ACCT_IMAGES, PNG_IMAGE_SIZE( image ), 1 );
+	if ( !pixels ) {
+		png_image_free( &image );
+		return NULL;
+	}
+	if ( !png_image_finish_read( &image, NULL, pixels, 0, NULL ) ) {
+		fprintf( stderr, "couldn't decode %s: %s\n", path, image.message );
+		AcctFree( ACCT_IMAGES, pixels );
+		return NULL;
+	}
+	*width = image.width;
+	*height = image.height;
+	return pixels;
+}
+
+// the next number in a PPM header, skipping whitespace and comments
+static int PpmNumber( const unsigned char** p, const unsigned char* end ) {
+	int n = -1;
+
+	while ( *p < end ) {
+		if ( **p == '#' ) {
+			while ( *p < end && **p != '\n' )
+				( *p )++;
+		} else if ( **p == ' ' || **p == '\t' || **p == '\r' || **p == '\n' ) {
+			( *p )++;
+		} else {
+			break;
+		}
+	}
+	while ( *p < end && **p >= '0' && **p <= '9' && n < WALLPAPER_MAX_SIZE ) {
+		n = ( n < 0 ? 0 : n * 10 ) + ( **p - '0' );
+		( *p )++;
+	}
+	return n;
+}
+
+static unsigned char* LoadPpm( const char* path, int* width, int* height ) {
+	const unsigned char* map,* p,* end;
+	unsigned char* pixels = NULL;
+	struct stat st;
+	size_t i, count;
+	int fd, maxval;
+
+	fd = open( path, O_RDONLY );
+	if ( fd < 0 || fstat( fd, &st ) < 0 || st.st_size < 3 ) {
+		if ( fd >= 0 )
+			close( fd );
+		return NULL;
+	}
+	map = mmap( NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0 );
+	close( fd );
+	if ( map == MAP_FAILED )
+		return NULL;
+
+	p = map + 2;
+	end = map + st.st_size;
+	*width = PpmNumber( &p, end );
+	*height = PpmNumber( &p, end );
+	maxval = PpmNumber( &p, end );
+	// exactly one whitespace byte comes before the pixels
+	p++;
+	count = (size_t)*width * *height;
+	if ( *width <= 0 || *height <= 0 || maxval != 255 || p > end || (size_t)( end - p ) < count * 3 ) {
+		fprintf( stderr, "%s is not an 8 bit binary PPM image\n", path );
+	} else {
+		pixels = AcctCalloc( ACCT_IMAGES, count, 4 );
+		for ( i = 0; pixels && i < count; i++ ) {
+			pixels[i * 4] = p[i * 3];
+			pixels[i * 4 + 1] = p[i * 3 + 1];
+			pixels[i * 4 + 2] = p[i * 3 + 2];
+			pixels[i * 4 + 3] = 0xff;
+		}
+	}
+	munmap( (void*)map, st.st_size );
+	return pixels;
+}
+
+static unsigned char* LoadImage( const char* path, int* width, int* height ) {
+	unsigned char magic[8] = { 0 };
+	FILE* f = fopen( path, "rb" );
+
+	if ( !f ) {
+		fprintf( stderr, "couldn't open wallpaper %s\n", path );
+		return NULL;
+	}
+	fread( magic, 1, sizeof( magic ), f );
+	fclose( f );
+	if ( !png_sig_cmp( magic, 0, sizeof( magic ) ) )
+		return LoadPng( path, width, height );
+	if ( magic[0] == 'P' && magic[1] == '6' )
+		return LoadPpm( path, width, height );
+	fprintf( stderr, "%s is neither a PNG nor a PPM image\n", path );
+	return NULL;
+}
+
+// a segment the server has attached too, or NULL if MIT-SHM isn't usable
+static unsigned char* AttachSegment( size_t size, xcb_shm_seg_t* seg ) {
+	const xcb_query_extension_reply_t* ext = xcb_get_extension_data( c, &xcb_shm_id );
+	xcb_generic_error_t* error;
+	unsigned char* mem;
+	int id;
+
+	if ( !ext || !ext->present )
+		return NULL;
+	id = shmget( IPC_PRIVATE, size, IPC_CREAT | 0600 );
+	if ( id < 0 )
+		return NULL;
+	mem = shmat( id, NULL, 0 );
+	if ( mem == (void*)-1 ) {
+		shmctl( id, IPC_RMID, NULL );
+		return NULL;
+	}
+	*seg = xcb_generate_id( c );
+	error = xcb_request_check( c, xcb_shm_attach_checked( c, *seg, id, 1 ) );
+	// the segment lives on until the server detaches as well
+	shmctl( id, IPC_RMID, NULL );
+	if ( error ) {
+		free( error );
+		shmdt( mem );
+		return NULL;
+	}
+	return mem;
+}
+
+// converts each scaled row in place, packing the rows to stride
+static void ConvertRows( const pixelFormat_t* f, unsigned char* mem, int width, int height, int stride ) {
+	int y;
+
+	for ( y = 0; y < height; y++ )
+		ConvertRGBA( f, mem + (size_t)y * width * 4, mem + (size_t)y * stride, width );
+}
+
+void WallpaperShutdown( void ) {
+	if ( !wallpaper )
+		return;
+	xcb_delete_property( c, screen->root, _XROOTPMAP_ID );
+	xcb_delete_property( c, screen->root, ESETROOT_PMAP_ID );
+	xcb_free_pixmap( c, wallpaper );
+	AcctXFree( ACCT_X_PIXMAP );
+	wallpaper = XCB_NONE;
+}
+
+// loads, scales and uploads the wallpaper. on any failure the root is left as it was.
+void LoadWallpaper( const char* path, const char* mode ) {
+	struct timespec start, decoded, scaled, end;
+	const unsigned char* src;
+	unsigned char* image,* mem;
+	pixelFormat_t format;
+	xcb_shm_seg_t seg;
+	xcb_gcontext_t gc;
+	int w = screen->width_in_pixels, h = screen->height_in_pixels;
+	int width = 0, height = 0, cropWidth, cropHeight, stride;
+	unsigned int v[1];
+	bool shared;
+
+	if ( !path || !path[0] )
+		return;
+	if ( !GetPixelFormat( &format ) ) {
+		fprintf( stderr, "wallpapers aren't supported on this visual\n" );
+		return;
+	}
+	clock_gettime( CLOCK_MONOTONIC, &start );
+	image = LoadImage( path, &width, &height );
+	if ( !image )
+		return;
+	clock_gettime( CLOCK_MONOTONIC, &decoded );
+
+	// fill takes the largest centred part of the image with the screen's shape
+	src = image;
+	cropWidth = width;
+	cropHeight = height;
+	if ( mode && !strcmp( mode, "fill" ) ) {
+		if ( (long long)width * h > (long long)height * w )
+			cropWidth = (long long)height * w / h;
+		else
+			cropHeight = (long long)width * h / w;
+		if ( cropWidth < 1 )
+			cropWidth = 1;
+		if ( cropHeight < 1 )
+			cropHeight = 1;
+		src += ( (size_t)( height - cropHeight ) / 2 * width + ( width - cropWidth ) / 2 ) * 4;
+	} else if ( mode && strcmp( mode, "stretch" ) ) {
+		fprintf( stderr, "wallpaper mode should be stretch or fill\n" );
+	}
+
+	// scaled as RGBA, then packed down to the visual's rows of whole words
+	stride = ( w * format.bpp / 8 + 3 ) & ~3;
+	mem = AttachSegment( (size_t)w * h * 4, &seg );
+	shared = ( mem != NULL );
+	if ( !shared )
+		mem = AcctCalloc( ACCT_IMAGES, (size_t)w * h, 4 );
+	if ( !mem || !ScaleImage( src, cropWidth, cropHeight, width * 4, mem, w, h, w * 4 ) ) {
+		fprintf( stderr, "couldn't scale the wallpaper\n" );
+		if ( shared ) {
+			xcb_shm_detach( c, seg );
+			shmdt( mem );
+		} else {
+			AcctFree( ACCT_IMAGES, mem );
+		}
+		AcctFree( ACCT_IMAGES, image );
+		return;
+	}
+	AcctFree( ACCT_IMAGES, image );
+	ConvertRows( &format, mem, w, h, stride );
+	clock_gettime( CLOCK_MONOTONIC, &scaled );
+
+	WallpaperShutdown();
+	wallpaper = xcb_generate_id( c );
+	xcb_create_pixmap( c, screen->root_depth, wallpaper, screen->root, w, h );
+	AcctXCreate( ACCT_X_PIXMAP );
+	gc = xcb_generate_id( c );
+	xcb_create_gc( c, gc, screen->root, 0, NULL );
+	AcctXCreate( ACCT_X_GC );
+	if ( shared ) {
+		xcb_shm_put_image( c, wallpaper, gc, stride * 8 / format.bpp, h, 0, 0, w, h, 0, 0,
+			screen->root_depth, XCB_IMAGE_FORMAT_Z_PIXMAP, 0, seg, 0 );
+		xcb_shm_detach( c, seg );
+		shmdt( mem );
+	} else {
+		PutBands( wallpaper, gc, mem, w, h, stride );
+		AcctFree( ACCT_IMAGES, mem );
+	}
+	xcb_free_gc( c, gc );
+	AcctXFree( ACCT_X_GC );
+
+	v[0] = wallpaper;
+	xcb_change_window_attributes( c, screen->root, XCB_CW_BACK_PIXMAP, v );
+	xcb_clear_area( c, 0, screen->root, 0, 0, 0, 0 );
+	xcb_change_property( c, XCB_PROP_MODE_REPLACE, screen->root, _XROOTPMAP_ID, XCB_ATOM_PIXMAP, 32, 1, &wallpaper );
+	xcb_change_property( c, XCB_PROP_MODE_REPLACE, screen->root, ESETROOT_PMAP_ID, XCB_ATOM_PIXMAP, 32, 1, &wallpaper );
+	clock_gettime( CLOCK_MONOTONIC, &end );
+
+	dbgprintf( 1, "wallpaper %s, %ix%i to %ix%i with %s: decode %.3f ms, scale %.3f ms, upload %.3f ms\n",
+		path, width, height, w, h, ScalePath(), MsBetween( &start, &decoded ),
+		MsBetween( &decoded, &scaled ), MsBetween( &scaled, &end ) );
+}
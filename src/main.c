@@ -2,9 +2,11 @@
 #include <stdlib.h>
 #include <signal.h>
 #include <string.h>
-#include <stdarg.h>
 #include <stdbool.h>
+#include <unistd.h>
 #include <pwd.h>
+#include <time.h>
+#include <poll.h>
 
 #include <sulfur/sulfur.h>
 
@@ -12,13 +14,10 @@
 
 #include "m_common.h"
 
-node_t *rootNode = NULL;
 xcb_connection_t *c;
 xcb_screen_t *screen;
 xcb_generic_event_t *e;
 
-int debugLevel = 99;
-
 sulfurColor_t colorWhite;
 sulfurColor_t colorLightGrey;
 sulfurColor_t colorGrey;
@@ -30,7 +29,6 @@ sulfurColor_t colorDarkAccent;
 
 unsigned int inactiveFontContext;
 unsigned int activeFontContext;
-unsigned int cursorContext;
 
 xcb_font_t windowFont;
 xcb_font_t cursorFont;
@@ -39,6 +37,16 @@ int lastCursor;
 
 xcb_atom_t WM_DELETE_WINDOW;
 xcb_atom_t WM_PROTOCOLS;
+xcb_atom_t _MOTIF_WM_HINTS;
+xcb_atom_t _GTK_FRAME_EXTENTS;
+xcb_atom_t _NET_WM_NAME;
+xcb_atom_t UTF8_STRING;
+xcb_atom_t WM_WINDOW_ROLE;
+xcb_atom_t _NET_WM_STATE;
+xcb_atom_t _NET_WM_STATE_FULLSCREEN;
+xcb_atom_t _XROOTPMAP_ID;
+xcb_atom_t ESETROOT_PMAP_ID;
+xcb_atom_t _NET_WM_PID;
 
 typedef enum {
 	RESIZE_NONE = 0,
@@ -49,6 +57,7 @@ typedef enum {
 wmState_t wmState = WMSTATE_IDLE;
 node_t *dragClient;
 bool dragChanged = false;
+bool dragMoved = false; // the current drag has moved at all, for tab merging
 short dragStartX, dragStartY;
 short dragNewX, dragNewY, dragNewW, dragNewH;
 short mouseLastKnownX;
@@ -56,11 +65,10 @@ short mouseLastKnownY;
 short mouseIsOverCloseButton;
 resizeDir_t resizeDir;
 
-nodeList_t windowList; // list of all windows, in most recently raised order
-nodeList_t redrawList; // list of all windows needing redrawn
-
 char *homedir;
 dictionary *dict;
+char **startArgv;
+char *startPath; // what Restart execs, resolved before main() leaves the launch directory
 
 int spawnx = 40, spawny = 40, spawnxdir = 20, spawnydir = 20;
 
@@ -73,149 +81,131 @@ Support functions
 void Cleanup( void );
 void Quit( int r );
 
-void dbgprintf( int level, char* fmt, ... ) {
-	va_list args;
-	va_start( args, fmt );
-	if ( level <= debugLevel ) {
-		vprintf( fmt, args );
-	}
-	va_end( args );
-}
+void FreeResources( void );
 
-void AddNodeToList( node_t* n, nodeList_t* list ) {
+void Cleanup( void ) {
 	int i;
 
-	for ( i = 0 ; i < list->max; i++ ) {
-		if ( list->nodes[i] == NULL || list->nodes[i] == n ) {
-			list->nodes[i] = n;
-			return;
-		}
-	}
-	dbgprintf( 2, "growing client list (current max is %i\n)\n", list->max );
-	list->nodes = realloc( list->nodes, sizeof ( node_t ) * ( list->max += 4 ) );
-	if ( list->nodes == NULL ) {
-		fprintf( stderr, "failure growing window list\n" );
-		Quit( 2 );
+	if ( !windowList.nodes )
+		return;
+	ReapNodes();
+
+	// the root can be anywhere in the list once clients have been raised
+	for ( i = 0; ( i < windowList.max ) && ( windowList.nodes[i] != NULL ); ) {
+		if ( windowList.nodes[i] == rootNode )
+			i++;
+		else
+			DestroyNode( windowList.nodes[i] );
 	}
-	for ( i = list->max - 4; i < list->max; i++ ) {
-		list->nodes[i] = NULL;
+	TileShutdown();
+	MapHintsShutdown();
+	TitlesShutdown();
+	UsageShutdown();
+	RulesShutdown();
+	if ( rootNode ) {
+		AcctFree( ACCT_LISTS, rootNode->children.nodes );
+		AcctFree( ACCT_NODES, rootNode );
+		rootNode = NULL;
 	}
-	dbgprintf( 2, "window list size is %i\n", list->max );
-	AddNodeToList( n, list );
-}
-
-void RemoveNodeFromList( node_t* n, nodeList_t* list ) {
-	int i;
+	AcctFree( ACCT_LISTS, windowList.nodes );
+	AcctFree( ACCT_LISTS, redrawList.nodes );
+	windowList.nodes = NULL;
+	redrawList.nodes = NULL;
+	FreeResources();
 
-	if ( !list || !n )
-		return;
+	if ( accountingEnabled && AcctLeakReport( LEAK_REPORT_NAME ) > 0 )
+		fprintf( stderr, "leaks found, see %s\n", LEAK_REPORT_NAME );
 
-	for ( i = 0 ; i < list->max; i++ ) {
-		if ( list->nodes[i] == n ) {
-			break;
-		}
-	}
-	if ( i >= list->max ) {
-		dbgprintf( 1, "node not found\n" );
-		return;
-	}
-	for ( i++ ; i < list->max; i++ ) {
-		list->nodes[i - 1] = list->nodes[i];
-		if ( list->nodes[i] == NULL ) {
-			break;
-		}
-	}
-	if ( i >= list->max )
-		list->nodes[list->max - 1] = NULL;
-	if ( i < list->max - 4 ) {
-		dbgprintf( 2, "shrinking client list\n" );
-		list->nodes = realloc( list->nodes, sizeof( node_t ) * ( list->max -= 4 ) );
-		if ( list == NULL ) {
-			fprintf( stderr, "failure shrinking client list\n" );
-			Quit( 2 );
-		}
-		dbgprintf( 2, "client list size is %i\n", list->max );
-	}
+	xcb_disconnect( c );
 }
 
-node_t* GetParentFrame( node_t* n ) {
-	node_t* p;
-	for ( p = n; ( p != NULL ) && ( p->type != NODE_FRAME ); p = p->parent )
-		;;
-	return p;
+void Quit( int r ) {
+	Cleanup();
+	exit( r );
 }
 
-node_t* CreateNode( nodeType_t type, xcb_window_t wnd, node_t* parent, short width, short height, short x, short y ) {
-	node_t* n = calloc( 1, sizeof( node_t ) );
-	if ( !n )
-		return NULL;
-	n->children.max = 4;
-	n->children.nodes = calloc( n->children.max, sizeof( node_t*) );
-	if ( !n->children.nodes ) {
-		free(n);
-		return NULL;
-	}
+/*
+============
+Tree backend
+============
+*/
 
-	strncpy( n->name, "untitled", 256 );
-	n->managementState = STATE_INIT;
-	n->windowState = STATE_WITHDRAWN;
-	n->type = type;
-	n->window = wnd;
-	n->parent = parent;
-	n->width = width;
-	n->height = height;
-	n->x = x;
-	n->y = y;
-	return n;
+static void BackendReparent( node_t* n, node_t* parent, short x, short y ) {
+	if ( n->window != XCB_NONE && parent->window != XCB_NONE )
+		TrackRequest( xcb_reparent_window( c, n->window, parent->window, x, y ), n->window, "reparent", ForgetWindow );
 }
 
-void DestroyNode( node_t* n ) {
-	int i = 0;
-
-	if ( !n || n->type == NODE_ROOT )
+static void BackendDestroy( node_t* n ) {
+	if ( n->window == XCB_NONE )
 		return;
+	if ( n->type == NODE_FRAME )
+		TextForgetFrame( n );
+	SwitcherForget( n );
+	UsageForget( n );
+	if ( !( n->reap & REAP_GONE ) )
+		TrackRequest( xcb_destroy_window( c, n->window ), n->window, "destroy", NULL );
+	if ( n->type == NODE_FRAME )
+		AcctXFree( ACCT_X_WINDOW );
+}
 
-	// reparent any child windows
-	if ( n->children.nodes && n->parent && n->parent->children.nodes ) {
-		for ( i = 0; ( i < n->children.max ) && ( n->children.nodes[i] != NULL ); i++ ) {
-			xcb_reparent_window( c, n->window, n->parent->window, n->x, n->y );
-			AddNodeToList( n->children.nodes[i], &n->parent->children );
-			RemoveNodeFromList( n->children.nodes[i], &n->children );
-		}
-	}
+static void BackendRestack( node_t* n, node_t* sibling ) {
+	unsigned int v[2] = { sibling ? sibling->window : XCB_NONE, XCB_STACK_MODE_ABOVE };
 
-	RemoveNodeFromList( n, &windowList );
-	RemoveNodeFromList( n, &redrawList );
-	RemoveNodeFromList( n, &n->parent->children );
-	xcb_destroy_window( c, n->window );
+	xcb_void_cookie_t cookie;
 
-	// if our parent is a frame or group, and it is empty, it should also be destroyed
-	if ( ( n->parent->type == NODE_FRAME ) || ( n->parent->type == NODE_GROUP ) ) {
-		if ( ( n->parent->children.nodes ) && ( n->parent->children.nodes[0] == NULL ) ) {
-			DestroyNode( n->parent );
-		}
-	}
-	free( n->children.nodes );
-	free( n );
+	if ( sibling )
+		cookie = xcb_configure_window( c, n->window, XCB_CONFIG_WINDOW_SIBLING | XCB_CONFIG_WINDOW_STACK_MODE, v );
+	else
+		cookie = xcb_configure_window( c, n->window, XCB_CONFIG_WINDOW_STACK_MODE, &v[1] );
+	TrackRequest( cookie, n->window, "restack", ForgetWindow );
 }
 
-void Cleanup( void ) {
-	if ( !windowList.nodes )
-		return;
+static void BackendFocus( node_t* n ) {
+	TrackRequest( xcb_set_input_focus( c, XCB_INPUT_FOCUS_POINTER_ROOT, n->window, XCB_CURRENT_TIME ), n->window, "focus", ForgetWindow );
+}
 
-	while ( windowList.nodes[0] != NULL && windowList.nodes[0] != rootNode ) {
-		DestroyNode( windowList.nodes[0] );
-	}
-	free( windowList.nodes[0]->children.nodes );
-	free( windowList.nodes[0] );
-	free( windowList.nodes );
+static void BackendDetach( node_t* n ) {
+	if ( n->type == NODE_FRAME )
+		TileRemove( n );
+}
 
-	xcb_disconnect( c );
+static void BackendOutOfMemory( void ) {
+	Quit( 2 );
 }
 
-void Quit( int r ) {
-	Cleanup();
-	exit( r );
+treeBackend_t xBackend = {
+	BackendReparent,
+	BackendDestroy,
+	BackendRestack,
+	BackendFocus,
+	BackendDetach,
+	TabClosed,
+	BackendOutOfMemory,
+};
+
+// counted for the stats, see ConfigureReport
+static long configureCalls, frameConfigures, clientConfigures, syntheticNotifies;
+
+// tells a framed client where it is on the root, which it can't learn from
+// its real ConfigureNotify events, and which it doesn't get any of when the
+// frame moves without a resize (ICCCM 4.1.5)
+static void SendSyntheticConfigure( node_t* n, node_t* p ) {
+	xcb_configure_notify_event_t e;
+
+	memset( &e, 0, sizeof( e ) );
+	e.response_type = XCB_CONFIGURE_NOTIFY;
+	e.event = n->window;
+	e.window = n->window;
+	e.above_sibling = XCB_NONE;
+	e.x = p->x + BORDER_SIZE_LEFT;
+	e.y = p->y + BORDER_SIZE_TOP;
+	e.width = n->width;
+	e.height = n->height;
+	e.border_width = 0;
+	e.override_redirect = 0;
+	TrackRequest( xcb_send_event( c, 0, n->window, XCB_EVENT_MASK_STRUCTURE_NOTIFY, (char*)&e ),
+		n->window, "configure notify", ForgetWindow );
+	syntheticNotifies++;
 }
 
 void ConfigureClient( node_t *n, short x, short y, unsigned short width, unsigned short height ) {
@@ -230,10 +220,16 @@ void ConfigureClient( node_t *n, short x, short y, unsigned short width, unsigne
 							XCB_CONFIG_WINDOW_HEIGHT |
 							XCB_CONFIG_WINDOW_BORDER_WIDTH;
 	int i;
-	node_t *p = GetParentFrame( n );
+	node_t *p;
+	bool resized, moved;
 
 	if ( n == NULL || n->type == NODE_FRAME )
 		return;
+	p = GetParentFrame( n );
+	// a size the client would only push back on isn't worth sending
+	if ( !n->fullscreen )
+		ConstrainSize( n, &width, &height );
+	configureCalls++;
 
 	nx = x;
 	ny = y;
@@ -252,6 +248,20 @@ void ConfigureClient( node_t *n, short x, short y, unsigned short width, unsigne
 	if ( ny < 0 ) {
 		ny = 0;
 	}
+	resized = ( width != n->configuredWidth || height != n->configuredHeight );
+
+	// without a frame the client is configured directly
+	if ( p == NULL ) {
+		unsigned int v[5] = { nx, ny, width, height, 0 };
+		n->x = nx;
+		n->y = ny;
+		n->width = n->configuredWidth = width;
+		n->height = n->configuredHeight = height;
+		TrackRequest( xcb_configure_window( c, n->window, pmask, v ), n->window, "configure", ForgetWindow );
+		clientConfigures++;
+		return;
+	}
+
 	unsigned int pv[5] = {
 		nx, 
 		ny, 
@@ -264,20 +274,106 @@ void ConfigureClient( node_t *n, short x, short y, unsigned short width, unsigne
 		height,
 		0
 	};
+	moved = ( nx != p->x || ny != p->y );
 	p->x = nx;
 	p->y = ny;
 	p->width = pv[2];
 	p->height = pv[3];
 	n->width = cv[0];
 	n->height = cv[1];
-	if ( p != NULL && n->parent == p )
-		xcb_configure_window( c, p->window, pmask, pv );
-	xcb_configure_window( c, n->window, cmask, cv );
+	if ( n->parent == p ) {
+		// a move only needs the frame's position
+		xcb_configure_window( c, p->window, resized ? pmask : XCB_CONFIG_WINDOW_X | XCB_CONFIG_WINDOW_Y, pv );
+		frameConfigures++;
+	}
+
+	// the client window is only touched when its size changes; otherwise,
+	// and after a move, it's told its new position with a synthetic event
+	if ( resized ) {
+		n->configuredWidth = width;
+		n->configuredHeight = height;
+		TrackRequest( xcb_configure_window( c, n->window, cmask, cv ), n->window, "configure", ForgetWindow );
+		clientConfigures++;
+	}
+	if ( n->parent == p && ( moved || !resized ) )
+		SendSyntheticConfigure( n, p );
+	if ( !resized )
+		return;
+
+	// hidden tabs are kept at the frame's size so switching needs no configure
+	for ( i = 0; ( i < p->children.max ) && ( p->children.nodes[i] != NULL ); i++ ) {
+		node_t* tab = p->children.nodes[i];
+		if ( tab == n || tab->type != NODE_CLIENT )
+			continue;
+		if ( tab->configuredWidth != n->width || tab->configuredHeight != n->height ) {
+			tab->width = tab->configuredWidth = n->width;
+			tab->height = tab->configuredHeight = n->height;
+			TrackRequest( xcb_configure_window( c, tab->window, cmask, cv ), tab->window, "configure", ForgetWindow );
+			clientConfigures++;
+		}
+	}
+}
+
+void ConfigureReport( FILE* f ) {
+	fprintf( f, "%-10s %10s %10s %10s %10s\n", "configure", "calls", "frames", "clients", "synthetic" );
+	fprintf( f, "%-10s %10li %10li %10li %10li\n", "", configureCalls, frameConfigures, clientConfigures, syntheticNotifies );
+}
+
+// the core font is fixed at six pixels a character
+int TitleWidth( const char* name ) {
+	if ( textEnabled )
+		return TextWidth( name );
+	return strnlen( name, 256 ) * 6;
+}
+
+void DrawTitle( node_t* frame, short x, const char* name, int maxWidth, bool active ) {
+	int len = strnlen( name, 256 );
+
+	if ( textEnabled ) {
+		TextDraw( frame, x, 14, name, maxWidth, active );
+		return;
+	}
+	if ( len > maxWidth / 6 )
+		len = maxWidth / 6;
+	if ( len > 0 && themeEnabled )
+		DrawThemedText( frame, x, 14, name, len, active ? activeFontContext : inactiveFontContext );
+	else if ( len > 0 )
+		xcb_image_text_8( c, len, frame->window, active ? activeFontContext : inactiveFontContext, x, 14, name );
+}
+
+// draws one labelled cell per client across the title bar
+void DrawTabs( node_t *frame, bool focused ) {
+	int i, count = GetTabCount( frame );
+	int span = frame->width - TAB_START - 4;
+	int cellWidth, cellX;
+	char label[USAGE_LABEL_SIZE];
+	node_t* tab;
+
+	if ( count < 1 || span < count )
+		return;
+	cellWidth = span / count;
+
+	for ( i = 0; ( i < frame->children.max ) && ( ( tab = frame->children.nodes[i] ) != NULL ); i++ ) {
+		cellX = TAB_START + i * cellWidth;
+
+		if ( tab == GetActiveTab( frame ) && focused ) {
+			SGrafDrawFill( frame->window, colorLightGrey, cellX, 3, cellWidth - 2, 12 );
+			DrawTitle( frame, cellX + 4, UsageLabel( tab, label, sizeof( label ) ), cellWidth - 8, true );
+		} else {
+			SGrafDrawFill( frame->window, colorWhite, cellX, 3, cellWidth - 2, 12 );
+			if ( tab == GetActiveTab( frame ) )
+				SGrafDrawRect( frame->window, colorDarkGrey, cellX, 3, cellWidth - 3, 12 );
+			DrawTitle( frame, cellX + 4, UsageLabel( tab, label, sizeof( label ) ), cellWidth - 8, false );
+		}
+	}
 }
 
 void DrawFrame( node_t *node ) {
-	int i, textLen = 0, textWidth = 0, textPos = 0;
+	int i, textWidth = 0, textPos = 0, textMax;
+	char label[USAGE_LABEL_SIZE];
+	const char* title;
 	node_t* frame,* child;
+	bool focused;
 
 	if( node == NULL || node->managementState == STATE_NO_REDIRECT ) {
 		return;
@@ -286,15 +382,30 @@ void DrawFrame( node_t *node ) {
 	frame = GetParentFrame( node );
 	if ( !frame )
 		return;
-	child = frame->children.nodes[0];
+	child = GetActiveTab( frame );
 	if ( !child )
 		child = frame;
-
-	textLen = strnlen( child->name, 256 );
-	textWidth = textLen * 6;
+	SetupFontGcs();
+
+	// keep clear of the close button
+	textMax = frame->width - 2 * TAB_START;
+	title = UsageLabel( child, label, sizeof( label ) );
+	textWidth = TitleWidth( title );
+	if ( textWidth > textMax )
+		textWidth = textMax;
 	textPos = ( ( frame->width + BORDER_SIZE_LEFT + BORDER_SIZE_RIGHT ) / 2 ) - ( textWidth / 2 );
 
-	if ( frame->children.nodes[0] == windowList.nodes[0] ) {
+	if ( themeEnabled ) {
+		focused = GetActiveTab( frame ) == windowList.nodes[0];
+		DrawThemedFrame( frame, focused, wmState == WMSTATE_CLOSE && mouseIsOverCloseButton );
+		if ( GetTabCount( frame ) > 1 )
+			DrawTabs( frame, focused );
+		else
+			DrawTitle( frame, textPos, title, textMax, focused );
+		return;
+	}
+
+	if ( GetActiveTab( frame ) == windowList.nodes[0] ) {
 		SGrafDrawFill( frame->window, colorLightGrey, 0, 0, frame->width - 1, frame->height - 1 );
 		SGrafDrawRect( frame->window, colorBlack, 0, 0, frame->width - 1, frame->height - 1 );
 
@@ -315,58 +426,25 @@ void DrawFrame( node_t *node ) {
 			SGrafDrawRect( frame->window, colorLightAccent, 10, 5, 9, 9 );
 			SGrafDrawFill( frame->window, colorGrey, 11, 6, 7, 7 );
 		}
-		SGrafDrawFill( frame->window, colorLightGrey, textPos - 8, 3, textWidth + 16, 12 );
-		xcb_image_text_8( c, textLen, frame->window, activeFontContext, textPos, 14, child->name );
+		if ( GetTabCount( frame ) > 1 ) {
+			DrawTabs( frame, true );
+		} else {
+			SGrafDrawFill( frame->window, colorLightGrey, textPos - 8, 3, textWidth + 16, 12 );
+			DrawTitle( frame, textPos, title, textMax, true );
+		}
 	} else {
 		SGrafDrawFill( frame->window, colorWhite, 0, 0, frame->width - 1, frame->height - 1 );
 		SGrafDrawRect( frame->window, colorDarkGrey, 0, 0, frame->width - 1, frame->height - 1 );
 
 		SGrafDrawLine( frame->window, colorDarkGrey, 1, BORDER_SIZE_TOP - 1, frame->width - 1, BORDER_SIZE_TOP - 1 );
-		xcb_image_text_8( c, textLen, frame->window, inactiveFontContext, textPos, 14, child->name );
+		if ( GetTabCount( frame ) > 1 )
+			DrawTabs( frame, false );
+		else
+			DrawTitle( frame, textPos, title, textMax, false );
 	}
 	return;
 }
 
-node_t* GetNodeByWindow( xcb_window_t w ) {
-	int i;
-	for ( i = 0 ; i < windowList.max; i++ )
-		if ( ( windowList.nodes[i] == NULL ) || ( windowList.nodes[i]->window == w ) )
-			return windowList.nodes[i];
-	return NULL;
-}
-
-void RaiseClient( node_t *n ) {
-	unsigned short mask = XCB_CONFIG_WINDOW_STACK_MODE;
-	unsigned int v[1] = { XCB_STACK_MODE_ABOVE };
-	node_t* p = GetParentFrame( n );
-	node_t* old = GetParentFrame( windowList.nodes[0] );
-	int i;
-	
-	if ( n == p )
-		n = p->children.nodes[0];
-
-	if ( !n )
-		return;
-
-	for ( i = 0; ( i < windowList.max ) && ( windowList.nodes[i] != NULL ) && ( windowList.nodes[i] != n ); i++ ) ;;
-	if ( i >= windowList.max || windowList.nodes[i] == NULL ) {
-		return;
-	}
-
-	for ( ; i >= 1 ; i-- )
-		windowList.nodes[i] = windowList.nodes[i - 1];
-
-	windowList.nodes[0] = n;
-
-	xcb_set_input_focus( c, XCB_INPUT_FOCUS_POINTER_ROOT, n->window, XCB_CURRENT_TIME );
-
-	AddNodeToList( p, &redrawList );
-	AddNodeToList( old, &redrawList );
-	if ( p )
-		xcb_configure_window( c, p->window, mask, v );
-	xcb_configure_window( c, n->window, mask, v );
-}
-
 sulfurColor_t GetDarkColor( const char* name ) {
 	if ( !strncmp( name, "bluebell", 16 ) ) {
 		return SGrafColor( 0xcc * 45 / 100, 0xcc * 45 / 100, 0xff * 45 / 100 );
@@ -446,46 +524,146 @@ void SetupColors() {
 	colorDarkAccent = GetDarkColor( accent );
 }
 
-void SetupAtoms() {	
-	WM_DELETE_WINDOW = xcb_intern_atom_reply( c, xcb_intern_atom( c, 0, strlen( "WM_DELETE_WINDOW" ), "WM_DELETE_WINDOW" ), NULL )->atom;
-	WM_PROTOCOLS = xcb_intern_atom_reply( c, xcb_intern_atom( c, 0, strlen( "WM_PROTOCOLS" ), "WM_PROTOCOLS" ), NULL )->atom;
+xcb_intern_atom_cookie_t deleteWindowCookie;
+xcb_intern_atom_cookie_t protocolsCookie;
+xcb_intern_atom_cookie_t motifHintsCookie;
+xcb_intern_atom_cookie_t frameExtentsCookie;
+xcb_intern_atom_cookie_t netNameCookie;
+xcb_intern_atom_cookie_t utf8Cookie;
+xcb_intern_atom_cookie_t roleCookie;
+xcb_intern_atom_cookie_t netStateCookie;
+xcb_intern_atom_cookie_t netFullscreenCookie;
+xcb_intern_atom_cookie_t rootPixmapCookie;
+xcb_intern_atom_cookie_t esetrootCookie;
+xcb_intern_atom_cookie_t netPidCookie;
+
+// sent early so the replies share a round trip with BecomeWM's check
+void RequestAtoms( void ) {
+	deleteWindowCookie = xcb_intern_atom( c, 0, strlen( "WM_DELETE_WINDOW" ), "WM_DELETE_WINDOW" );
+	protocolsCookie = xcb_intern_atom( c, 0, strlen( "WM_PROTOCOLS" ), "WM_PROTOCOLS" );
+	motifHintsCookie = xcb_intern_atom( c, 0, strlen( "_MOTIF_WM_HINTS" ), "_MOTIF_WM_HINTS" );
+	frameExtentsCookie = xcb_intern_atom( c, 0, strlen( "_GTK_FRAME_EXTENTS" ), "_GTK_FRAME_EXTENTS" );
+	netNameCookie = xcb_intern_atom( c, 0, strlen( "_NET_WM_NAME" ), "_NET_WM_NAME" );
+	utf8Cookie = xcb_intern_atom( c, 0, strlen( "UTF8_STRING" ), "UTF8_STRING" );
+	roleCookie = xcb_intern_atom( c, 0, strlen( "WM_WINDOW_ROLE" ), "WM_WINDOW_ROLE" );
+	netStateCookie = xcb_intern_atom( c, 0, strlen( "_NET_WM_STATE" ), "_NET_WM_STATE" );
+	netFullscreenCookie = xcb_intern_atom( c, 0, strlen( "_NET_WM_STATE_FULLSCREEN" ), "_NET_WM_STATE_FULLSCREEN" );
+	rootPixmapCookie = xcb_intern_atom( c, 0, strlen( "_XROOTPMAP_ID" ), "_XROOTPMAP_ID" );
+	esetrootCookie = xcb_intern_atom( c, 0, strlen( "ESETROOT_PMAP_ID" ), "ESETROOT_PMAP_ID" );
+	netPidCookie = xcb_intern_atom( c, 0, strlen( "_NET_WM_PID" ), "_NET_WM_PID" );
+}
+
+xcb_atom_t GetAtomReply( xcb_intern_atom_cookie_t cookie ) {
+	xcb_intern_atom_reply_t* reply = xcb_intern_atom_reply( c, cookie, NULL );
+	xcb_atom_t atom = XCB_ATOM_NONE;
+
+	if ( reply ) {
+		atom = reply->atom;
+		free( reply );
+	}
+	return atom;
+}
+
+void SetupAtoms() {
+	WM_DELETE_WINDOW = GetAtomReply( deleteWindowCookie );
+	WM_PROTOCOLS = GetAtomReply( protocolsCookie );
+	_MOTIF_WM_HINTS = GetAtomReply( motifHintsCookie );
+	_GTK_FRAME_EXTENTS = GetAtomReply( frameExtentsCookie );
+	_NET_WM_NAME = GetAtomReply( netNameCookie );
+	UTF8_STRING = GetAtomReply( utf8Cookie );
+	WM_WINDOW_ROLE = GetAtomReply( roleCookie );
+	_NET_WM_STATE = GetAtomReply( netStateCookie );
+	_NET_WM_STATE_FULLSCREEN = GetAtomReply( netFullscreenCookie );
+	_XROOTPMAP_ID = GetAtomReply( rootPixmapCookie );
+	ESETROOT_PMAP_ID = GetAtomReply( esetrootCookie );
+	_NET_WM_PID = GetAtomReply( netPidCookie );
 }
 
 void SetupFontGc( xcb_gc_t* ctx, sulfurColor_t fg, sulfurColor_t bg, xcb_font_t font ) {
 	unsigned int v[3] = { fg, bg, font };
 	*ctx = xcb_generate_id( c );
 	xcb_create_gc( c, *ctx, screen->root, XCB_GC_FOREGROUND | XCB_GC_BACKGROUND, v );
+	AcctXCreate( ACCT_X_GC );
 }
 
 void SetupFonts() {
 	windowFont = xcb_generate_id( c );
 	xcb_open_font( c, windowFont, strnlen( FONT_NAME, 256 ), FONT_NAME );
+	AcctXCreate( ACCT_X_FONT );
 
-	cursorFont = xcb_generate_id( c );
-	xcb_open_font( c, cursorFont, strlen( "cursor" ), "cursor" );
+	SetupText( iniparser_getstring( dict, "font:file", NULL ),
+		iniparser_getint( dict, "font:size", 11 ),
+		iniparser_getint( dict, "font:cache", 512 ) );
+}
 
+// the title GCs aren't needed until the first frame is drawn
+void SetupFontGcs( void ) {
+	if ( activeFontContext )
+		return;
 	SetupFontGc( &activeFontContext, colorBlack, colorLightGrey, windowFont );
 	SetupFontGc( &inactiveFontContext, colorDarkGrey, colorWhite, windowFont );
-	SetupFontGc( &cursorContext, colorBlack, colorWhite, cursorFont );
+}
+
+void FreeResources( void ) {
+	int i;
+
+	// frames outlive us across a restart, their pictures must not
+	for ( i = 0; ( i < windowList.max ) && windowList.nodes && ( windowList.nodes[i] != NULL ); i++ ) {
+		if ( windowList.nodes[i]->type == NODE_FRAME )
+			TextForgetFrame( windowList.nodes[i] );
+	}
+	SwitcherShutdown();
+	TextShutdown();
+	ThemeShutdown();
+	WallpaperShutdown();
+	TraceShutdown();
+	if ( activeFontContext ) {
+		xcb_free_gc( c, activeFontContext );
+		xcb_free_gc( c, inactiveFontContext );
+		AcctXFree( ACCT_X_GC );
+		AcctXFree( ACCT_X_GC );
+		activeFontContext = inactiveFontContext = 0;
+	}
+	if ( windowFont ) {
+		xcb_close_font( c, windowFont );
+		AcctXFree( ACCT_X_FONT );
+		windowFont = 0;
+	}
+	if ( cursorFont ) {
+		xcb_close_font( c, cursorFont );
+		AcctXFree( ACCT_X_FONT );
+		cursorFont = 0;
+	}
 }
 
 void SetCursor( int cur ) {
+	// the cursor font is opened the first time the pointer needs changing
+	if ( !cursorFont ) {
+		cursorFont = xcb_generate_id( c );
+		xcb_open_font( c, cursorFont, strlen( "cursor" ), "cursor" );
+		AcctXCreate( ACCT_X_FONT );
+	}
 	if ( cur != lastCursor ) {
 		cursor = xcb_generate_id( c );
 		xcb_create_glyph_cursor ( c, cursor, cursorFont, cursorFont, cur, cur + 1, 0, 0, 0, 65535, 65535, 65535);
+		AcctXCreate( ACCT_X_CURSOR );
 		xcb_change_window_attributes ( c, rootNode->window, XCB_CW_CURSOR, &cursor );
 		xcb_free_cursor( c, cursor );
-		cur = lastCursor;
+		AcctXFree( ACCT_X_CURSOR );
+		lastCursor = cur;
 	}
 }
 
-int BecomeWM( void ) {
+xcb_void_cookie_t BecomeWMRequest( void ) {
 	unsigned int v[1];
-	xcb_void_cookie_t cookie;
-	xcb_generic_error_t *error;
 
 	v[0] = XCB_EVENT_MASK_POINTER_MOTION | XCB_EVENT_MASK_SUBSTRUCTURE_NOTIFY | XCB_EVENT_MASK_SUBSTRUCTURE_REDIRECT;
-	cookie = xcb_change_window_attributes_checked( c, screen->root, XCB_CW_EVENT_MASK, v );
+	return xcb_change_window_attributes_checked( c, screen->root, XCB_CW_EVENT_MASK, v );
+}
+
+int BecomeWM( xcb_void_cookie_t cookie ) {
+	xcb_generic_error_t *error;
+
 	error = xcb_request_check( c, cookie );
 	if ( error ) {
 		free( error );
@@ -494,64 +672,42 @@ int BecomeWM( void ) {
 	return 0;
 } 
 
-void SetRootBackground() {
-	return;
-	int w = screen->width_in_pixels, h = screen->height_in_pixels;
-	xcb_pixmap_t fill = xcb_generate_id( c );
-	xcb_pixmap_t pixmap = xcb_generate_id( c );
-	unsigned int v[1] = { pixmap };
-
-	xcb_create_pixmap( c, screen->root_depth, fill, screen->root, 2, 2 );
-	xcb_create_pixmap( c, screen->root_depth, pixmap, screen->root, w, h );
-
-	SGrafDrawFill( pixmap, colorGrey, 0, 0, w, h );
-
-	// draw rounded corners
-	SGrafDrawLine( pixmap, colorBlack, 0, 0, 0, 4 );
-	SGrafDrawLine( pixmap, colorBlack, 1, 0, 4, 0 );
-	SGrafDrawLine( pixmap, colorBlack, 1, 1, 1, 2 );
-	SGrafDrawLine( pixmap, colorBlack, 1, 1, 2, 1 );
-
-	SGrafDrawLine( pixmap, colorBlack, w - 1, 0, w - 5, 0 );
-	SGrafDrawLine( pixmap, colorBlack, w - 1, 0, w - 1, 4 );
-	SGrafDrawLine( pixmap, colorBlack, w - 2, 1, w - 2, 2 );
-	SGrafDrawLine( pixmap, colorBlack, w - 2, 1, w - 3, 1 );
-
-	SGrafDrawLine( pixmap, colorBlack, 0, h - 1, 0, h - 5 );
-	SGrafDrawLine( pixmap, colorBlack, 1, h - 1, 4, h - 1 );
-	SGrafDrawLine( pixmap, colorBlack, 1, h - 2, 1, h - 3 );
-	SGrafDrawLine( pixmap, colorBlack, 1, h - 2, 2, h - 2 );
-
-	SGrafDrawLine( pixmap, colorBlack, w - 1, h - 1, w - 5, h - 1 );
-	SGrafDrawLine( pixmap, colorBlack, w - 1, h - 1, w - 1, h - 5 );
-	SGrafDrawLine( pixmap, colorBlack, w - 2, h - 2, w - 2, h - 3 );
-	SGrafDrawLine( pixmap, colorBlack, w - 2, h - 2, w - 3, h - 2 );
-	
-	xcb_change_window_attributes( c, screen->root, XCB_CW_BACK_PIXMAP, v );
-	xcb_clear_area( c, 1, screen->root, 0, 0, w, h );
-	xcb_free_pixmap( c, pixmap );
-	xcb_free_pixmap( c, fill );
-}
 
 void SetupRoot() {
 	rootNode = CreateNode( NODE_ROOT, screen->root, NULL, screen->width_in_pixels, screen->height_in_pixels, 0, 0 );
 	AddNodeToList(rootNode, &windowList );
-	SetRootBackground();
 }
 
-void ReparentWindow( xcb_window_t win, xcb_window_t parent, short x, short y, unsigned short width, unsigned short height, unsigned char override_redirect ) {
+// creates a new window frame and reparents the client to it
+node_t* CreateFrame( node_t* n, short x, short y ) {
+	node_t* p;
+	unsigned int v[2] = { colorWhite, FRAME_EVENT_MASK };
+	xcb_window_t frame = xcb_generate_id( c );
+	int frameWidth = n->width + BORDER_SIZE_LEFT + BORDER_SIZE_RIGHT + 1;
+	int frameHeight = n->height + BORDER_SIZE_TOP + BORDER_SIZE_BOTTOM + 1;
+
+	// created where it goes, since it's often mapped in the same batch
+	xcb_create_window (		c, XCB_COPY_FROM_PARENT, frame, screen->root, 
+					x, y, frameWidth, frameHeight, 
+					0, XCB_WINDOW_CLASS_INPUT_OUTPUT, screen->root_visual, 
+					XCB_CW_BACK_PIXEL | XCB_CW_EVENT_MASK, v);
+	AcctXCreate( ACCT_X_WINDOW );
+	p = CreateNode( NODE_FRAME, frame, rootNode, frameWidth, frameHeight, x, y );
+	TrackRequest( xcb_reparent_window( c, n->window, p->window, BORDER_SIZE_LEFT, BORDER_SIZE_TOP ), n->window, "reparent", ForgetWindow );
+	n->parent = p;
+	AddNodeToList( p, &windowList );
+	AddNodeToList( p, &rootNode->children );
+	p->managementState = n->managementState = STATE_REPARENTED;
+	return p;
+}
+
+node_t* ReparentWindow( xcb_window_t win, xcb_window_t parent, short x, short y, unsigned short width, unsigned short height, unsigned char override_redirect ) {
 	node_t* n;
 	node_t* p;
-	unsigned int v[2] = { 	colorWhite, 
-							XCB_EVENT_MASK_EXPOSURE | 
-							XCB_EVENT_MASK_BUTTON_PRESS | 
-							XCB_EVENT_MASK_BUTTON_RELEASE | 
-							XCB_EVENT_MASK_POINTER_MOTION | 
-							XCB_EVENT_MASK_SUBSTRUCTURE_NOTIFY | 
-							XCB_EVENT_MASK_SUBSTRUCTURE_REDIRECT };
+	unsigned int v[1];
 
 	if ( GetNodeByWindow( win ) != NULL )
-		return;
+		return NULL;
 	p = GetNodeByWindow( parent );
 	if ( !p )
 		p = rootNode;
@@ -560,20 +716,7 @@ void ReparentWindow( xcb_window_t win, xcb_window_t parent, short x, short y, un
 	n->managementState = STATE_WITHDRAWN;
 
 	if ( p == rootNode && !override_redirect ) {
-		// create a new window frame and reparent the client to it
-		xcb_window_t frame = xcb_generate_id( c );
-		int frameWidth = width + BORDER_SIZE_LEFT + BORDER_SIZE_RIGHT + 1;
-		int frameHeight = height + BORDER_SIZE_TOP + BORDER_SIZE_BOTTOM + 1;
-		xcb_create_window (		c, XCB_COPY_FROM_PARENT, frame, screen->root, 
-						0, 0, frameWidth, frameHeight, 
-						0, XCB_WINDOW_CLASS_INPUT_OUTPUT, screen->root_visual, 
-						XCB_CW_BACK_PIXEL | XCB_CW_EVENT_MASK, v);
-		p = CreateNode( NODE_FRAME, frame, rootNode, frameWidth, frameHeight, x, y );
-		xcb_reparent_window( c, n->window, p->window, BORDER_SIZE_LEFT, BORDER_SIZE_TOP );
-		n->parent = p;
-		AddNodeToList( p, &windowList );
-		AddNodeToList( p, &rootNode->children );
-		p->managementState = n->managementState = STATE_REPARENTED;
+		TrackTopLevel( n );
 		dbgprintf( 2, "New normal window\n");
 	} else if ( p != rootNode ) {
 		n->managementState = STATE_CHILD;
@@ -583,61 +726,180 @@ void ReparentWindow( xcb_window_t win, xcb_window_t parent, short x, short y, un
 		dbgprintf( 2, "New unreparented window\n" );
 	}
 
-	v[0] = 	XCB_EVENT_MASK_EXPOSURE | 
-						XCB_EVENT_MASK_PROPERTY_CHANGE |
-						XCB_EVENT_MASK_SUBSTRUCTURE_NOTIFY | 
-						XCB_EVENT_MASK_SUBSTRUCTURE_REDIRECT;
+	v[0] = CLIENT_EVENT_MASK;
 
-	xcb_change_window_attributes( c, n->window, XCB_CW_EVENT_MASK, v );
+	TrackRequest( xcb_change_window_attributes( c, n->window, XCB_CW_EVENT_MASK, v ), n->window, "select input", ForgetWindow );
 	AddNodeToList( n, &p->children );
 	AddNodeToList( n, &windowList );
-	RaiseClient( n );
+	// a top-level is raised when it first maps
+	if ( n->managementState != STATE_TRACKED )
+		RaiseClient( n );
+	return n;
 }
 
-void ReparentExistingWindows() {
-	xcb_query_tree_cookie_t treecookie;
+void ReparentExistingWindows( xcb_query_tree_cookie_t treecookie ) {
 	xcb_query_tree_reply_t *treereply;
-	xcb_get_geometry_cookie_t geocookie;
+	xcb_get_geometry_cookie_t *geocookies;
 	xcb_get_geometry_reply_t *georeply;
-	xcb_get_window_attributes_cookie_t attrcookie;
+	xcb_get_window_attributes_cookie_t *attrcookies;
 	xcb_get_window_attributes_reply_t *attrreply;
-	int i;
+	int i, count;
 	xcb_window_t *children;
+	node_t* n;
 
-	treecookie = xcb_query_tree( c, screen->root );
 	treereply = xcb_query_tree_reply( c, treecookie, NULL );
 	if ( treereply == NULL ) {
 		return;
 	}
 	children = xcb_query_tree_children( treereply );
-	for( i = 0; i < xcb_query_tree_children_length( treereply ); i++ ) {
-		geocookie = xcb_get_geometry( c, children[i] );
-		georeply = xcb_get_geometry_reply( c, geocookie, NULL );
-		attrcookie = xcb_get_window_attributes( c, children[i] );
-		attrreply = xcb_get_window_attributes_reply( c, attrcookie, NULL );
+	count = xcb_query_tree_children_length( treereply );
+	geocookies = AcctCalloc( ACCT_STARTUP, count + 1, sizeof( xcb_get_geometry_cookie_t ) );
+	attrcookies = AcctCalloc( ACCT_STARTUP, count + 1, sizeof( xcb_get_window_attributes_cookie_t ) );
+	if ( !geocookies || !attrcookies ) {
+		AcctFree( ACCT_STARTUP, geocookies );
+		AcctFree( ACCT_STARTUP, attrcookies );
+		free( treereply );
+		return;
+	}
+
+	// ask about every window before waiting on any of the answers
+	for( i = 0; i < count; i++ ) {
+		// frames adopted from a restart are already known
+		if ( GetNodeByWindow( children[i] ) != NULL )
+			continue;
+		geocookies[i] = xcb_get_geometry( c, children[i] );
+		attrcookies[i] = xcb_get_window_attributes( c, children[i] );
+	}
+	for( i = 0; i < count; i++ ) {
+		if ( GetNodeByWindow( children[i] ) != NULL )
+			continue;
+		georeply = xcb_get_geometry_reply( c, geocookies[i], NULL );
+		attrreply = xcb_get_window_attributes_reply( c, attrcookies[i], NULL );
 		if ( ( georeply != NULL ) && ( attrreply != NULL) && ( attrreply->override_redirect == 0 ) ) {
-			ReparentWindow( children[i], screen->root, georeply->x, georeply->y, georeply->width, georeply->height, 0 );
+			n = ReparentWindow( children[i], screen->root, georeply->x, georeply->y, georeply->width, georeply->height, 0 );
+			// no MapRequest will come for windows already on screen
+			if ( n && attrreply->map_state == XCB_MAP_STATE_VIEWABLE ) {
+				n->windowState = STATE_NORMAL;
+				n->parentMapped = 1;
+				RequestMapHints( n );
+			}
 		}
 		if ( georeply )
 			free( georeply );
 		if ( attrreply )
 			free ( attrreply );
 	}
+	AcctFree( ACCT_STARTUP, geocookies );
+	AcctFree( ACCT_STARTUP, attrcookies );
 	free( treereply );
 }
 
+// replaces the running process with a fresh copy of makron. the frames are
+// left alive on the server and handed over through a state file, so clients
+// keep their placement and nothing gets unmapped.
+void Restart( void ) {
+	char fdStr[16];
+	char** args;
+	int fd, i, argc, count = 0;
+
+	// everything that can fail is checked while there's still a connection to
+	// go back to. past the disconnect, the clients sit in frames nobody manages.
+	if ( strchr( startPath, '/' ) && access( startPath, X_OK ) < 0 ) {
+		perror( startPath );
+		fprintf( stderr, "not restarting\n" );
+		return;
+	}
+	for ( argc = 0; startArgv[argc] != NULL; argc++ )
+		;;
+	args = calloc( argc + 3, sizeof( char* ) );
+	if ( !args ) {
+		perror( "restart" );
+		return;
+	}
+
+	// nothing destroyed earlier in this batch should be handed over
+	ReapNodes();
+	fd = SaveState();
+
+	if ( fd < 0 ) {
+		fprintf( stderr, "couldn't save state, not restarting\n" );
+		free( args );
+		return;
+	}
+	snprintf( fdStr, sizeof( fdStr ), "%i", fd );
+
+	// the same arguments, with the old state file swapped for the new one
+	for ( i = 0; i < argc; i++ ) {
+		if ( !strcmp( startArgv[i], "--restore" ) && i + 1 < argc ) {
+			i++;
+			continue;
+		}
+		args[count++] = startArgv[i];
+	}
+	args[count++] = "--restore";
+	args[count++] = fdStr;
+	args[count] = NULL;
+
+	FreeResources();
+	xcb_set_close_down_mode( c, XCB_CLOSE_DOWN_RETAIN_PERMANENT );
+	xcb_flush( c );
+	xcb_disconnect( c );
+
+	dbgprintf( 1, "restarting\n" );
+	execvp( startPath, args );
+	perror( "exec" );
+	exit( 1 );
+}
+
 /*
 ==============
 Event handlers
 ==============
 */
 
+// the node a drag moves: a frame, or a client that has none
+static node_t* GetDragTarget( node_t* n ) {
+	node_t* p = GetParentFrame( n );
+	return p ? p : n;
+}
+
+// the client whose geometry a drag changes
+static node_t* GetDragClient( void ) {
+	if ( dragClient->type == NODE_FRAME )
+		return GetActiveTab( dragClient );
+	return dragClient;
+}
+
+// drops the current drag, if any, without applying it
+void EndDrag( void ) {
+	dragChanged = false;
+	dragMoved = false;
+	wmState = WMSTATE_IDLE;
+	resizeDir = RESIZE_NONE;
+	dragClient = NULL;
+	dragStartX = 0;
+	dragStartY = 0;
+}
+
 void DoButtonPress( xcb_button_press_event_t *e ) {
 	node_t *n = GetNodeByWindow( e->event );
 
+	if ( SwitcherButtonPress( e ) )
+		return;
+	if ( n == NULL )
+		return;
 	RaiseClient( n );
-	if ( n->type == NODE_CLIENT )
+	if ( n->type == NODE_CLIENT ) {
+		// only the modifier bindings grab on clients
+		if ( ( e->state & DRAG_MODIFIER ) && n->managementState != STATE_CHILD && !n->fullscreen ) {
+			dragClient = GetDragTarget( n );
+			wmState = ( e->detail == XCB_BUTTON_INDEX_3 ) ? WMSTATE_RESIZE : WMSTATE_DRAG;
+			resizeDir = RESIZE_HORIZONTAL | RESIZE_VERTICAL;
+			dragStartX = e->root_x - dragClient->x;
+			dragStartY = e->root_y - dragClient->y;
+		}
 		return;
+	}
 
 	if ( n->type == NODE_FRAME ) {
 		if ( mouseIsOverCloseButton ) {
@@ -645,6 +907,15 @@ void DoButtonPress( xcb_button_press_event_t *e ) {
 			AddNodeToList( n, &redrawList );
 			return;
 		} else {
+			if ( e->event_y < BORDER_SIZE_TOP && GetTabCount( n ) > 1 ) {
+				node_t* tab = GetTabAtPoint( n, e->event_x );
+				if ( tab && e->detail == XCB_BUTTON_INDEX_2 ) {
+					DetachTab( tab, true );
+					return;
+				}
+				if ( tab && tab != GetActiveTab( n ) )
+					SelectTab( n, tab );
+			}
 			if ( e->event_x > n->width - 8 || e->event_y > n->height - 8 ) {
 				wmState = WMSTATE_RESIZE;
 				resizeDir = RESIZE_NONE;
@@ -665,24 +936,27 @@ void DoButtonPress( xcb_button_press_event_t *e ) {
 }
 
 void DoButtonRelease( xcb_button_release_event_t *e ) {
+	node_t* target;
+
 	SetCursor( 68 );
 	switch ( wmState ) {
 		case WMSTATE_IDLE:
 			break;
 		case WMSTATE_DRAG:
 		case WMSTATE_RESIZE:
-			if ( dragChanged )
-				ConfigureClient( dragClient->children.nodes[0], dragNewX, dragNewY, dragNewW, dragNewH );
-			dragChanged = false;
-			wmState = WMSTATE_IDLE;
-			resizeDir = RESIZE_NONE;
-			dragClient = NULL;
-			dragStartX = 0;
-			dragStartY = 0;
+			target = ( wmState == WMSTATE_DRAG && dragMoved && dragClient->type == NODE_FRAME ) ?
+				GetFrameAtTitleBar( e->root_x, e->root_y, dragClient ) : NULL;
+			if ( target )
+				MergeFrames( target, dragClient );
+			else if ( dragChanged && IsTiled( dragClient ) && wmState == WMSTATE_RESIZE )
+				TileResize( dragClient, dragNewW, dragNewH );
+			else if ( dragChanged && !IsTiled( dragClient ) )
+				ConfigureClient( GetDragClient(), dragNewX, dragNewY, dragNewW, dragNewH );
+			EndDrag();
 			break;
 		case WMSTATE_CLOSE:
 			if ( mouseIsOverCloseButton == 1 ) {
-				xcb_client_message_event_t *msg = calloc(32, 1);
+				xcb_client_message_event_t *msg = AcctCalloc( ACCT_MESSAGES, 32, 1 );
 				msg->response_type = XCB_CLIENT_MESSAGE;
 				msg->window = windowList.nodes[0]->window;
 				msg->format = 32;
@@ -692,7 +966,7 @@ void DoButtonRelease( xcb_button_release_event_t *e ) {
 				msg->data.data32[1] = XCB_CURRENT_TIME;
 				xcb_send_event( c, 0, windowList.nodes[0]->window, XCB_EVENT_MASK_NO_EVENT, (char*)msg );
 				
-				free( msg );
+				AcctFree( ACCT_MESSAGES, msg );
 			}
 			wmState = WMSTATE_IDLE;
 			AddNodeToList( windowList.nodes[0], &redrawList );
@@ -706,6 +980,7 @@ void DoButtonRelease( xcb_button_release_event_t *e ) {
 void DoMotionNotify( xcb_motion_notify_event_t *e ) {
 	node_t* n;
 	int x, y, w, h;
+	unsigned short size[2];
 
 	mouseLastKnownX = e->root_x;
 	mouseLastKnownY = e->root_y;
@@ -724,22 +999,31 @@ void DoMotionNotify( xcb_motion_notify_event_t *e ) {
 		case WMSTATE_DRAG:
 			dragNewX = e->root_x - dragStartX;
 			dragNewY =  e->root_y - dragStartY;
-			dragNewW = dragClient->children.nodes[0]->width;
-			dragNewH = dragClient->children.nodes[0]->height;
+			dragNewW = GetDragClient()->width;
+			dragNewH = GetDragClient()->height;
 			dragChanged = true;
+			dragMoved = true;
 			return;
 		case WMSTATE_RESIZE:
 			dragNewX = dragClient->x;
 			dragNewY = dragClient->y;
-			dragNewW = e->root_x - ( dragNewX + BORDER_SIZE_LEFT );
-			dragNewH = e->root_y - ( dragNewY + BORDER_SIZE_TOP );
+			dragNewW = e->root_x - dragNewX;
+			dragNewH = e->root_y - dragNewY;
+			if ( dragClient->type == NODE_FRAME ) {
+				dragNewW -= BORDER_SIZE_LEFT;
+				dragNewH -= BORDER_SIZE_TOP;
+			}
 			if ( dragNewH < 16 )
 				dragNewH = 16;
 			if ( dragNewW < 16 )
 				dragNewW = 16;
+			// follow the client's increments as the pointer moves
+			size[0] = dragNewW;
+			size[1] = dragNewH;
+			ConstrainSize( GetDragClient(), &size[0], &size[1] );
+			dragNewW = size[0];
+			dragNewH = size[1];
 			dragChanged = true;
-			printf("resize w%hi h%hi\n", dragNewW, dragNewH );
-			printf( "dcX %hi dcY %hi nX %hi nY %hi\n", dragNewX, dragNewY, dragClient->children.nodes[0]->x, dragClient->children.nodes[0]->y );
 			return;
 		default:
 			n = GetNodeByWindow( e->event );
@@ -759,7 +1043,16 @@ void DoMotionNotify( xcb_motion_notify_event_t *e ) {
 	}
 }
 
+void DoKeyPress( xcb_key_press_event_t *e ) {
+	SwitcherKeyPress( e );
+}
+
+void DoKeyRelease( xcb_key_release_event_t *e ) {
+	SwitcherKeyRelease( e );
+}
+
 void DoExpose( xcb_expose_event_t *e ) {
+	SwitcherExpose( e->window );
 	AddNodeToList( GetNodeByWindow( e->window ), &redrawList );
 }
 
@@ -782,12 +1075,55 @@ void DoCreateNotify( xcb_create_notify_event_t *e ) {
 	ReparentWindow( e->window, e->parent, x, y, e->width, e->height, e->override_redirect );
 }
 
+// maps a client and its frame, if it has one, and brings it to the front
+void ShowClient( node_t* n ) {
+	node_t* p = GetParentFrame( n );
+
+	n->parentMapped = 1;
+	if ( p )
+		xcb_map_window( c, p->window );
+	TrackRequest( xcb_map_window( c, n->window ), n->window, "map", ForgetWindow );
+	TileInsert( p );
+	RaiseClient( n );
+}
+
+// maps n without raising or focusing it, stacked just below focused
+void ShowClientBehind( node_t* n, node_t* focused ) {
+	node_t* p = GetParentFrame( n );
+	node_t* top = p ? p : n;
+	node_t* above = GetParentFrame( focused );
+	unsigned int v[2];
+
+	if ( !above )
+		above = focused;
+	// restacked before it maps, so it never shows on top
+	if ( top != above ) {
+		v[0] = above->window;
+		v[1] = XCB_STACK_MODE_BELOW;
+		TrackRequest( xcb_configure_window( c, top->window, XCB_CONFIG_WINDOW_SIBLING | XCB_CONFIG_WINDOW_STACK_MODE, v ),
+			top->window, "restack", ForgetWindow );
+	}
+	n->parentMapped = 1;
+	if ( p )
+		xcb_map_window( c, p->window );
+	TrackRequest( xcb_map_window( c, n->window ), n->window, "map", ForgetWindow );
+	TileInsert( p );
+
+	// second in the stacking order, under the focused window
+	MoveNodeToFront( n, &windowList );
+	windowList.nodes[0] = focused;
+	windowList.nodes[1] = n;
+	if ( p )
+		AddNodeToList( p, &redrawList );
+}
+
+// the node goes at the end of the batch, see ReapNodes
 void DoDestroy( xcb_destroy_notify_event_t *e ) {
 	node_t* node = GetNodeByWindow( e->window );
 	if ( node )
-		DestroyNode( node );
+		QueueDestroy( node );
 	else
-		fprintf(stderr, "warning: window removed that was not in window list\n");
+		dbgprintf( 1, "window %x removed that was not in window list, or was already forgotten\n", e->window );
 }
 
 void DoMapRequest( xcb_map_request_event_t *e ) {
@@ -802,10 +1138,12 @@ void DoMapRequest( xcb_map_request_event_t *e ) {
 		return;
 	}
 	n->windowState = STATE_NORMAL;
-	if ( p )
-		xcb_map_window( c, p->window );
-	xcb_map_window( c, n->window );
-	RaiseClient( n );
+	if ( GetTabCount( p ) > 1 && GetActiveTab( p ) != n ) {
+		SelectTab( p, n );
+		return;
+	}
+	// mapping waits for the decoration hints, see m_hints.c
+	RequestMapHints( n );
 	dbgprintf( 2, "window %x mapped\n", e->window );
 }
 
@@ -822,9 +1160,7 @@ void DoMapNotify( xcb_map_notify_event_t *e ) {
 	if ( n->parentMapped == 0 ) {  
 		n->windowState = STATE_NORMAL;
 		n->parentMapped = 1;
-		if ( p )
-			xcb_map_window( c, p->window );
-		RaiseClient( n );
+		RequestMapHints( n );
 	}
 }
 
@@ -835,11 +1171,19 @@ void DoUnmapNotify( xcb_unmap_notify_event_t *e ) {
 	if ( n == NULL ) {
 		return;
 	}
+	if ( n->ignoreUnmap > 0 ) {
+		n->ignoreUnmap--;
+		return;
+	}
 	if ( n->parentMapped == 1 ) {
 		n->windowState = STATE_WITHDRAWN;
 		n->parentMapped = 0;
-		if ( p )
-			xcb_unmap_window( c, p->window );
+		// the window gets new contents when it comes back
+		if ( !p )
+			SwitcherForget( n );
+		// a withdrawn tab leaves its frame rather than hiding its siblings,
+		// and a frame of its own goes until the window maps again
+		ReleaseClient( n );
 	}
 }
 
@@ -850,7 +1194,10 @@ void DoReparentNotify( xcb_reparent_notify_event_t *e ) {
 		return;
 	}
 
-	n->managementState = STATE_REPARENTED;
+	if ( GetParentFrame( n ) )
+		n->managementState = STATE_REPARENTED;
+	// the new parent may have left it with a border, so send everything
+	n->configuredWidth = n->configuredHeight = 0;
 	ConfigureClient( n, n->x, n->y, n->width, n->height );
 	dbgprintf( 1, "window %x reparented to window %x\n", e->window, e->parent );
 	return;
@@ -874,6 +1221,16 @@ void DoConfigureRequest( xcb_configure_request_event_t *e ) {
 	width = n->width;
 	height = n->height;
 
+	// tiled and fullscreen clients keep the geometry we gave them
+	if ( n->fullscreen ) {
+		ConfigureClient( n, 0, 0, rootNode->width, rootNode->height );
+		return;
+	}
+	if ( IsTiled( p ) ) {
+		ConfigureClient( n, x, y, width, height );
+		return;
+	}
+
 	if ( ( e->value_mask & XCB_CONFIG_WINDOW_X ) != 0 )
 		x = e->x;
 	if ( ( e->value_mask & XCB_CONFIG_WINDOW_Y ) != 0 )
@@ -891,56 +1248,73 @@ void DoConfigureNotify( xcb_configure_notify_event_t *e ) {
 }
 
 void DoPropertyNotify( xcb_property_notify_event_t *e ) {
-	xcb_get_property_cookie_t cookie;
-    xcb_get_property_reply_t *reply;
 	node_t *n = GetNodeByWindow( e->window );
 
 	if ( n == NULL )
 		return;
 
-	if ( e->atom == XCB_ATOM_WM_NAME ) {
-		cookie = xcb_get_property( c, 0, e->window, XCB_ATOM_WM_NAME, XCB_ATOM_STRING, 0, 256 );
-		if ((reply = xcb_get_property_reply(c, cookie, NULL))) {
-			int len = xcb_get_property_value_length(reply);
-			if ( len != 0 ) {
-				memset( n->name, '\0', 256 );
-				strncpy( n->name, (char*)xcb_get_property_value( reply ), len > 255 ? 255 : len );
-				AddNodeToList( n, &redrawList );
-			}
-		}	
-		free( reply );
-	} else {
-		dbgprintf( 1, "window %x updated unknown atom %s\n", e->window, xcb_get_atom_name_name( xcb_get_atom_name_reply( c, xcb_get_atom_name( c, e->atom ), NULL ) ) );
+	// _NET_WM_NAME is UTF-8, which the title renderer can draw
+	if ( e->atom == XCB_ATOM_WM_NAME || e->atom == _NET_WM_NAME ) {
+		QueueTitle( n, e->atom );
+	} else if ( e->atom == XCB_ATOM_WM_NORMAL_HINTS ) {
+		RequestNormalHints( n );
+	} else if ( debugLevel >= 1 ) {
+		xcb_get_atom_name_reply_t* nameReply = xcb_get_atom_name_reply( c, xcb_get_atom_name( c, e->atom ), NULL );
+		if ( nameReply ) {
+			dbgprintf( 1, "window %x updated unknown atom %.*s\n", e->window,
+				xcb_get_atom_name_name_length( nameReply ), xcb_get_atom_name_name( nameReply ) );
+			free( nameReply );
+		}
 	}
 }
 
+// atom names from the server aren't null terminated
+static bool AtomNameIs( xcb_get_atom_name_reply_t* reply, const char* name ) {
+	int len = strlen( name );
+	return ( xcb_get_atom_name_name_length( reply ) == len ) && !strncmp( xcb_get_atom_name_name( reply ), name, len );
+}
+
 void DoClientMessage( xcb_client_message_event_t *e ) {
-	int i;
 	xcb_get_atom_name_cookie_t nameCookie;
 	xcb_get_atom_name_reply_t* nameReply;
 
+	// clients send these often enough that they shouldn't cost a round trip
+	if ( e->type == _NET_WM_STATE ) {
+		FullscreenMessage( e );
+		return;
+	}
+
 	nameCookie = xcb_get_atom_name( c, e->type );
 	nameReply = xcb_get_atom_name_reply( c, nameCookie, NULL );
+	if ( !nameReply )
+		return;
 
 	dbgprintf( 2, "received client message\n" );
 	dbgprintf( 2, "format: %i\n", e->format );
-	dbgprintf( 2, "type: %s\n", xcb_get_atom_name_name( nameReply ) );
-	if ( !strcmp( xcb_get_atom_name_name( nameReply ), "_NET_WM_STATE" ) ) {
-		dbgprintf( 2, "message is _NET_WM_STATE\n" );
-		for ( i = 0; i < 3; i++ ) {
-			if ( e->data.data32[i] == 0 )
-				break;
-			nameCookie = xcb_get_atom_name( c, e->data.data32[i] );
-			nameReply = xcb_get_atom_name_reply( c, nameCookie, NULL );
-			dbgprintf( 2, "data[i]: %s\n", xcb_get_atom_name_name( nameReply ) );
-		}
-	} else if ( !strcmp( xcb_get_atom_name_name( nameReply ), "_MAKRON_RELOAD" ) ) {
+	dbgprintf( 2, "type: %.*s\n", xcb_get_atom_name_name_length( nameReply ), xcb_get_atom_name_name( nameReply ) );
+	if ( AtomNameIs( nameReply, "_MAKRON_RELOAD" ) ) {
 		dbgprintf( 2, "reloading config\n" );
 		dict = iniparser_load( ".makronrc" );
 		SetupColors();
 		iniparser_freedict( dict );
+		dict = NULL;
 		AddNodeToList( windowList.nodes[0], &redrawList );
+	} else if ( AtomNameIs( nameReply, "_MAKRON_RESTART" ) ) {
+		free( nameReply );
+		Restart();
+		return;
+	} else if ( AtomNameIs( nameReply, "_MAKRON_STATS" ) ) {
+		AcctReport( stdout );
+		TextReport( stdout );
+		ErrorReport( stdout );
+		TitleReport( stdout );
+		UsageReport( stdout );
+		ManageReport( stdout );
+		ConfigureReport( stdout );
+		TraceWrite();
+		fflush( stdout );
 	}
+	free( nameReply );
 }
 
 /*
@@ -949,12 +1323,66 @@ Main function
 =============
 */
 
+struct timespec phaseStart, startupStart;
+
+double MsSince( struct timespec* since ) {
+	struct timespec now;
+	clock_gettime( CLOCK_MONOTONIC, &now );
+	return ( now.tv_sec - since->tv_sec ) * 1000.0 + ( now.tv_nsec - since->tv_nsec ) / 1000000.0;
+}
+
+// waits for the next event, but only until a deferred title is due
+xcb_generic_event_t* WaitForEvent( void ) {
+	struct pollfd fd = { xcb_get_file_descriptor( c ), POLLIN, 0 };
+	xcb_generic_event_t* e;
+	int timeout = TitleTimeout(), usage = UsageTimeout();
+
+	if ( usage >= 0 && ( timeout < 0 || usage < timeout ) )
+		timeout = usage;
+	if ( timeout < 0 )
+		return xcb_wait_for_event( c );
+	// events xcb has already read won't wake poll
+	if ( ( e = xcb_poll_for_event( c ) ) != NULL || timeout == 0 )
+		return e;
+	if ( poll( &fd, 1, timeout ) > 0 )
+		return xcb_poll_for_event( c );
+	return NULL;
+}
+
+void StartupPhase( const char* name ) {
+	dbgprintf( 1, "startup: %-16s %8.3f ms\n", name, MsSince( &phaseStart ) );
+	clock_gettime( CLOCK_MONOTONIC, &phaseStart );
+}
+
 int main( int argc, char** argv ) {
+	int i, restoreFd = -1;
+	xcb_void_cookie_t wmCookie;
+	xcb_query_tree_cookie_t treeCookie;
+	traceTime_t batchStart, redrawStart, spanStart;
+
+	startArgv = argv;
+	// a relative path stops meaning anything once we chdir home. a bare name
+	// is looked up in PATH, which the chdir doesn't affect.
+	startPath = strchr( argv[0], '/' ) ? realpath( argv[0], NULL ) : argv[0];
+	if ( !startPath )
+		startPath = "/proc/self/exe";
+	treeBackend = &xBackend;
+	for ( i = 1; i < argc - 1; i++ ) {
+		if ( !strcmp( argv[i], "--restore" ) )
+			restoreFd = atoi( argv[i + 1] );
+	}
+	for ( i = 1; i < argc; i++ ) {
+		if ( !strcmp( argv[i], "--account" ) )
+			accountingEnabled = true;
+	}
+
 	signal( SIGTERM, Quit );
 	signal( SIGINT, Quit );
 
 	printf( "%s %s build %s\n\n", PROGRAM_NAME, VERSION_STRING, VERSION_BUILDSTR );
 
+	clock_gettime( CLOCK_MONOTONIC, &startupStart );
+	phaseStart = startupStart;
 	if ( SulfurInit( NULL ) != 0 ) {
 			fprintf( stderr, "Problem starting up. Is X running?\n" );
 			Cleanup();
@@ -962,19 +1390,34 @@ int main( int argc, char** argv ) {
 	}
 	c = sulfurGetXcbConn();
 	screen = sulfurGetXcbScreen();
-
-	if ( BecomeWM() < 0 ) {
-		fprintf( stderr, "it looks like another wm is running.\n" );
-		fprintf( stderr, "you will need to close it before you can run makron.\n" );
-		Cleanup();
-		return 1;
+	StartupPhase( "connect" );
+
+	// everything that needs a reply is queued behind the redirect request,
+	// so checking it costs the only blocking round trip until windows are adopted
+	wmCookie = BecomeWMRequest();
+	RequestAtoms();
+	treeCookie = xcb_query_tree( c, screen->root );
+
+	// when restarting, the old instance's connection may not be gone yet
+	for ( i = 0; BecomeWM( wmCookie ) < 0; i++ ) {
+		if ( restoreFd < 0 || i >= 50 ) {
+			fprintf( stderr, "it looks like another wm is running.\n" );
+			fprintf( stderr, "you will need to close it before you can run makron.\n" );
+			Cleanup();
+			return 1;
+		}
+		usleep( 2000 );
+		xcb_discard_reply( c, treeCookie.sequence );
+		wmCookie = BecomeWMRequest();
+		treeCookie = xcb_query_tree( c, screen->root );
 	}
+	StartupPhase( "become wm" );
 
 	/* initialize the client list to empty */
 	windowList.max = 4;
-	windowList.nodes = calloc( windowList.max, sizeof ( node_t* ) );
+	windowList.nodes = AcctCalloc( ACCT_LISTS, windowList.max, sizeof ( node_t* ) );
 	redrawList.max = 4;
-	redrawList.nodes = calloc( redrawList.max, sizeof ( node_t* ) );
+	redrawList.nodes = AcctCalloc( ACCT_LISTS, redrawList.max, sizeof ( node_t* ) );
 
 	homedir = getenv( "HOME" );
 	if ( !homedir ) {
@@ -989,18 +1432,51 @@ int main( int argc, char** argv ) {
 	if ( !dict ) {
 		fprintf( stderr, "couldn't open .makronrc\n" );
 	}
+	tilingEnabled = iniparser_getboolean( dict, "layout:tiling", 0 );
+	csdEnabled = iniparser_getboolean( dict, "decorations:csd", 1 );
+	titleInterval = iniparser_getint( dict, "titles:interval", 100 );
+	SetupUsage( iniparser_getboolean( dict, "usage:overlay", 0 ), iniparser_getint( dict, "usage:interval", 2000 ) );
+	if ( iniparser_getboolean( dict, "debug:accounting", 0 ) )
+		accountingEnabled = true;
+	SetupTrace( iniparser_getstring( dict, "debug:trace", NULL ), iniparser_getint( dict, "debug:tracespans", 65536 ) );
+	StartupPhase( "config" );
 	SetupAtoms();
+	StartupPhase( "atoms" );
+	LoadRules();
+	StartupPhase( "rules" );
 	SetupColors();
+	StartupPhase( "colors" );
 	SetupFonts();
+	StartupPhase( "fonts" );
+	LoadTheme( iniparser_getstring( dict, "theme:path", NULL ) );
+	StartupPhase( "theme" );
 	SetupRoot();
-	SetCursor( 68 );
-	ReparentExistingWindows();
+	SetupSwitcher();
+	StartupPhase( "root" );
+	if ( restoreFd >= 0 && RestoreState( restoreFd ) < 0 )
+		fprintf( stderr, "couldn't restore saved state\n" );
+	ReparentExistingWindows( treeCookie );
+	TileAll();
+	StartupPhase( "adopt windows" );
+	xcb_flush( c );
+	dbgprintf( 1, "startup: %-16s %8.3f ms\n", "total", MsSince( &startupStart ) );
+
+	// nothing is waiting on the background, so it can go out after startup
+	LoadWallpaper( iniparser_getstring( dict, "wallpaper:file", NULL ), iniparser_getstring( dict, "wallpaper:mode", NULL ) );
 	iniparser_freedict( dict );
+	dict = NULL;
 
-	e = xcb_wait_for_event( c );
+	e = WaitForEvent();
 	while( !xcb_connection_has_error( c ) ) {
-		do {
+		batchStart = TraceNow();
+		// a NULL event means a deferred title or a usage sample is due
+		while ( e != NULL ) {
+			spanStart = TraceNow();
+			RetireRequests( e->full_sequence );
 			switch( e->response_type & ~0x80 ) {
+				case 0:						HandleError( (xcb_generic_error_t *)e ); break;
+				case XCB_KEY_PRESS: 		DoKeyPress( (xcb_key_press_event_t *)e ); break;
+				case XCB_KEY_RELEASE: 		DoKeyRelease( (xcb_key_release_event_t *)e ); break;
 				case XCB_BUTTON_PRESS: 		DoButtonPress( (xcb_button_press_event_t *)e ); break;
 				case XCB_BUTTON_RELEASE: 	DoButtonRelease( (xcb_button_release_event_t *)e ); break;
 				case XCB_MOTION_NOTIFY: 	DoMotionNotify( (xcb_motion_notify_event_t *)e ); break;
@@ -1015,20 +1491,54 @@ int main( int argc, char** argv ) {
 				case XCB_CONFIGURE_REQUEST: DoConfigureRequest( (xcb_configure_request_event_t *)e ); break;
 				case XCB_PROPERTY_NOTIFY: 	DoPropertyNotify( (xcb_property_notify_event_t *)e ); break;
 				case XCB_CLIENT_MESSAGE: 	DoClientMessage( (xcb_client_message_event_t *)e ); break;
-				default: 					dbgprintf( 1, "warning, unhandled event #%d\n", e->response_type & ~0x80 ); break;
+				default:
+					if ( !SwitcherEvent( e ) )
+						dbgprintf( 1, "warning, unhandled event #%d\n", e->response_type & ~0x80 );
+					break;
 			}
+			TraceSpan( TraceEventName( e->response_type & ~0x80 ), spanStart, XCB_NONE );
 			free( e );
-		} while( !xcb_connection_has_error( c ) && ( ( e = xcb_poll_for_event( c ) ) != NULL ) );
+			e = xcb_connection_has_error( c ) ? NULL : xcb_poll_for_event( c );
+		}
+		spanStart = TraceNow();
+		ReapNodes();
+		TraceSpan( "reap", spanStart, XCB_NONE );
+		spanStart = TraceNow();
+		FlushMapHints();
+		TraceSpan( "map hints", spanStart, XCB_NONE );
+		spanStart = TraceNow();
+		FlushTitles();
+		TraceSpan( "titles", spanStart, XCB_NONE );
+		spanStart = TraceNow();
+		FlushUsage();
+		TraceSpan( "usage", spanStart, XCB_NONE );
 		if ( dragClient && dragChanged ) {
-			ConfigureClient( dragClient->children.nodes[0], dragNewX, dragNewY, dragNewW, dragNewH );
+			spanStart = TraceNow();
+			// tiled frames can be dragged onto a title bar to tab them, but never move
+			if ( !IsTiled( dragClient ) )
+				ConfigureClient( GetDragClient(), dragNewX, dragNewY, dragNewW, dragNewH );
+			else if ( wmState == WMSTATE_RESIZE )
+				TileResize( dragClient, dragNewW, dragNewH );
 			dragChanged = false;
+			TraceSpan( "drag configure", spanStart, dragClient ? dragClient->window : XCB_NONE );
 		}
+		spanStart = TraceNow();
+		FlushLayout();
+		TraceSpan( "layout", spanStart, XCB_NONE );
+		redrawStart = TraceNow();
 		while ( redrawList.nodes[0] != NULL ) {
+			spanStart = TraceNow();
 			DrawFrame( redrawList.nodes[0] );
+			TraceSpan( "draw frame", spanStart, redrawList.nodes[0]->window );
 			RemoveNodeFromList( redrawList.nodes[0], &redrawList );
 		}
+		SwitcherFlush();
+		TraceSpan( "redraw", redrawStart, XCB_NONE );
+		spanStart = TraceNow();
 		xcb_flush( c );
-		e = xcb_wait_for_event( c );
+		TraceSpan( "flush", spanStart, XCB_NONE );
+		TraceSpan( "batch", batchStart, XCB_NONE );
+		e = WaitForEvent();
 	}
 	Cleanup();
 	printf( "connection closed. goodbye!\n" );
@@ -31,6 +31,8 @@ xcb_screen_t *screen;
 xcb_connection_t* c;
 xcb_pixmap_t icon;
 
+const char* message = "_MAKRON_RELOAD";
+
 const char* homeDir;
 
 /*
@@ -55,6 +57,12 @@ Main function
 */
 
 int main( int argc, char** argv ) {
+	if ( argc > 1 && !strcmp( argv[1], "restart" ) ) {
+		message = "_MAKRON_RESTART";
+	} else if ( argc > 1 && !strcmp( argv[1], "stats" ) ) {
+		message = "_MAKRON_STATS";
+	}
+
 	if ( SulfurInit( NULL ) != 0 ) {
 			printf( "Problem starting up. Is X running?\n" );
 			Cleanup();
@@ -78,7 +86,7 @@ int main( int argc, char** argv ) {
     event.format = 8;
     event.sequence = 0;
     event.window = screen->root;
-    event.type = xcb_intern_atom_reply( c, xcb_intern_atom( c, 0, strlen( "_MAKRON_RELOAD" ), "_MAKRON_RELOAD" ), NULL )->atom;
+    event.type = xcb_intern_atom_reply( c, xcb_intern_atom( c, 0, strlen( message ), message ), NULL )->atom;
     
     xcb_send_event( c, 0, screen->root, XCB_EVENT_MASK_SUBSTRUCTURE_NOTIFY, &event );
 	xcb_flush( c );